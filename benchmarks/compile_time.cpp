@@ -0,0 +1,42 @@
+// Compile time benchmark of the shape and type computations. Instantiates MATRIXD_BENCHMARK_SHAPES distinct 4D
+// and 5D shapes and computes their swapped, cropped, sub, dot product and continuous types without instantiating
+// those. The compile_benchmark target only runs the front end on it and reports its time and memory.
+#include <matrixd.hpp>
+
+#include <cstdint>
+#include <utility>
+
+#ifndef MATRIXD_BENCHMARK_SHAPES
+#define MATRIXD_BENCHMARK_SHAPES 200
+#endif
+
+template <typename ... Ms>
+struct type_list
+{
+};
+
+template <int i>
+struct shape_types
+{
+    using m4 = khustup::matrixd<float, 2 + i % 7, 3 + i % 5, 4 + i / 35, 5>;
+    using m5 = khustup::matrixd<float, 2, 1 + i % 3, 3 + i % 7, 4, 2 + i / 21>;
+    using w4 = khustup::matrixd<float, 2 + i % 7, 3 + i % 5, 5, 3>;
+
+    using swapped = typename m4::template swap_axes_matrix_type<0, 3>;
+    using cropped = typename m4::template cropped_matrix_type<1, 1, 1, 2, 0, 3, 0, 5>;
+    using sub = typename m5::template submatrix_type<2>;
+    using dot = typename m4::template dot_product_type<w4>;
+    using continuous = khustup::impl::continuous_matrix_type_from_matrix<typename m5::template swap_axes_matrix_type<1, 4>>;
+
+    static constexpr int64_t value = m4::volume +
+                                     std::get<2>(m5::absolute_offsets) +
+                                     sizeof(type_list<swapped, cropped, sub, dot, continuous>);
+};
+
+template <std::size_t ... i>
+constexpr int64_t total(std::index_sequence<i ...>) noexcept
+{
+    return (shape_types<i>::value + ... + 0);
+}
+
+static_assert(total(std::make_index_sequence<MATRIXD_BENCHMARK_SHAPES>{}) > 0);
@@ -2,180 +2,782 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
 #include <future>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
 #include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <version>
+
+#if defined(__cpp_lib_mdspan)
+#include <mdspan>
+#endif
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+
+/// @brief Byte alignment of owned matrix storage.
+#ifndef KHUSTUP_ALIGNMENT
+#define KHUSTUP_ALIGNMENT 64
+#endif
+
+/// @brief Pins the workers of parallel loops to the NUMA nodes, worker t of n to node t * nodes / n, on machines
+/// with more than one node.
+#ifndef KHUSTUP_NUMA_PINNING
+#define KHUSTUP_NUMA_PINNING 1
+#endif
+
+/// @brief Owned matrices of at most this many bytes keep their elements inside the matrix object. Moving them copies
+/// the elements, so views, data() pointers and iterators of the moved-from matrix don't follow the move.
+#ifndef KHUSTUP_INLINE_BYTES
+#define KHUSTUP_INLINE_BYTES 64
+#endif
+
+/// @brief Owned storage of at least this many bytes is backed by 2 MB huge pages, 0 disables huge pages.
+#ifndef KHUSTUP_HUGE_PAGE_THRESHOLD
+#define KHUSTUP_HUGE_PAGE_THRESHOLD 0
+#endif
 
 /// @brief Helper Metafunctions.
 namespace khustup {
 
 static constexpr int threads = 4;
 static constexpr int crit_compl = 1e6;
+static constexpr int vector_bytes = 32;
+static constexpr std::size_t alignment = KHUSTUP_ALIGNMENT;
+static constexpr std::size_t huge_page_bytes = std::size_t{2} << 20;
+static constexpr std::size_t huge_page_threshold = KHUSTUP_HUGE_PAGE_THRESHOLD;
+static constexpr std::size_t inline_bytes = KHUSTUP_INLINE_BYTES;
+
+static constexpr bool numa_pinning = KHUSTUP_NUMA_PINNING;
+
+static_assert((alignment & (alignment - 1)) == 0, "Alignment should be a power of two");
 
 namespace impl {
 
-template <int ... sizes_and_offsets>
-constexpr inline int64_t volume = 1;
+#ifdef __linux__
+/// @brief CPUs of every NUMA node, from sysfs, read once.
+inline const std::vector<cpu_set_t>& numa_nodes() noexcept
+{
+    static const std::vector<cpu_set_t> nodes = []() {
+        std::vector<cpu_set_t> r;
+        for (int n = 0;; ++n) {
+            const auto path = "/sys/devices/system/node/node" + std::to_string(n) + "/cpulist";
+            std::FILE* f = std::fopen(path.c_str(), "r");
+            if (f == nullptr) {
+                break;
+            }
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            int first;
+            int last;
+            while (std::fscanf(f, "%d", &first) == 1) {
+                last = first;
+                if (std::fscanf(f, "-%d", &last) != 1) {
+                    last = first;
+                }
+                for (int c = first; c <= last && c < CPU_SETSIZE; ++c) {
+                    CPU_SET(c, &set);
+                }
+                if (std::fgetc(f) != ',') {
+                    break;
+                }
+            }
+            std::fclose(f);
+            r.push_back(set);
+        }
+        return r;
+    }();
+    return nodes;
+}
+#endif
+
+}
 
-template <int abs_size, int abs_offset, int offset, int size, int ... tail>
-constexpr inline int64_t volume<abs_size, abs_offset, offset, size, tail ...> = size * volume<tail ...>;
+namespace impl {
 
-template <int ... sizes_and_offsets>
-constexpr inline auto extracted_abs_sizes = std::make_tuple();
+/// @brief Field of every axis of a layout, the (abs_size, abs_offset, offset, size) quadruples of the axes:
+/// 0 for abs_size to 3 for size.
+template <int field, std::size_t n>
+constexpr std::array<int, n / 4> layout_field(const std::array<int, n>& layout) noexcept
+{
+    std::array<int, n / 4> r{};
+    for (std::size_t k = 0; k < n / 4; ++k) {
+        r[k] = layout[4 * k + field];
+    }
+    return r;
+}
+
+/// @brief Number of elements of a layout.
+template <std::size_t n>
+constexpr int64_t layout_volume(const std::array<int, n>& layout) noexcept
+{
+    int64_t r = 1;
+    for (std::size_t k = 3; k < n; k += 4) {
+        r *= layout[k];
+    }
+    return r;
+}
 
-template <int abs_size, int abs_offset, int offset, int size, int ... tail>
-constexpr inline auto extracted_abs_sizes<abs_size, abs_offset, offset, size, tail ...> =
-    std::tuple_cat(std::make_tuple(abs_size), extracted_abs_sizes<tail ...>);
+template <std::size_t n, std::size_t ... i>
+constexpr auto tuple_from_array(const std::array<int, n>& a, std::index_sequence<i ...>) noexcept
+{
+    return std::make_tuple(a[i] ...);
+}
 
 template <int ... sizes_and_offsets>
-constexpr inline auto extracted_abs_offsets = std::make_tuple();
+constexpr inline int64_t volume = layout_volume(std::array<int, sizeof...(sizes_and_offsets)>{sizes_and_offsets ...});
 
-template <int abs_size, int abs_offset, int offset, int size, int ... tail>
-constexpr inline auto extracted_abs_offsets<abs_size, abs_offset, offset, size, tail ...> =
-    std::tuple_cat(std::make_tuple(abs_offset), extracted_abs_offsets<tail ...>);
+/// @brief Type of offsets among count elements: int unless they may exceed INT_MAX, so small matrices keep 32 bit
+/// address arithmetic.
+template <int64_t count>
+using offset_type = std::conditional_t<(count > std::numeric_limits<int>::max()), std::ptrdiff_t, int>;
+
+/// @brief Tuple of a field of every axis, one pack expansion instead of a recursion per axis.
+template <int field, int ... sizes_and_offsets>
+constexpr inline auto extracted_field =
+    tuple_from_array(layout_field<field>(std::array<int, sizeof...(sizes_and_offsets)>{sizes_and_offsets ...}),
+                     std::make_index_sequence<sizeof...(sizes_and_offsets) / 4>{});
 
 template <int ... sizes_and_offsets>
-constexpr inline auto extracted_sizes = std::make_tuple();
+constexpr inline auto extracted_abs_sizes = extracted_field<0, sizes_and_offsets ...>;
 
-template <int abs_size, int abs_offset, int offset, int size, int ... tail>
-constexpr inline auto extracted_sizes<abs_size, abs_offset, offset, size, tail ...> =
-    std::tuple_cat(std::make_tuple(size), extracted_sizes<tail ...>);
+template <int ... sizes_and_offsets>
+constexpr inline auto extracted_abs_offsets = extracted_field<1, sizes_and_offsets ...>;
 
 template <int ... sizes_and_offsets>
-constexpr inline auto extracted_offsets = std::make_tuple();
+constexpr inline auto extracted_offsets = extracted_field<2, sizes_and_offsets ...>;
 
-template <int abs_size, int abs_offset, int offset, int size, int ... tail>
-constexpr inline auto extracted_offsets<abs_size, abs_offset, offset, size, tail ...> =
-    std::tuple_cat(std::make_tuple(offset), extracted_offsets<tail ...>);
+template <int ... sizes_and_offsets>
+constexpr inline auto extracted_sizes = extracted_field<3, sizes_and_offsets ...>;
 
-template <int ... values>
-constexpr inline int product = 1;
+}
 
-template <int value, int ... tail>
-constexpr inline int product<value, tail ...> = value * product<tail ...>;
+}
 
-template <int s, typename S>
-struct integer_sequence_add_element;
+namespace khustup {
 
-template <int s, int ... values>
-struct integer_sequence_add_element<s, std::integer_sequence<int, values ...>>
+/// @brief Memory resource of aligned blocks from the global heap, 2 MB huge pages at or above huge_page_threshold.
+class aligned_memory_resource : public std::pmr::memory_resource
 {
-    using type = std::integer_sequence<int, values ..., s>;
+private:
+    static std::pair<std::size_t, std::size_t> layout(std::size_t bytes, std::size_t align) noexcept
+    {
+        if (huge_page_threshold != 0 && bytes >= huge_page_threshold) {
+            return {(bytes + huge_page_bytes - 1) / huge_page_bytes * huge_page_bytes,
+                    std::max(align, huge_page_bytes)};
+        }
+        return {bytes, std::max(align, alignment)};
+    }
+
+    void* do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        const auto [b, a] = layout(bytes, align);
+        void* p = ::operator new(b, std::align_val_t{a});
+#ifdef __linux__
+        if (a == huge_page_bytes) {
+            ::madvise(p, b, MADV_HUGEPAGE);
+        }
+#endif
+        return p;
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t align) override
+    {
+        const auto [b, a] = layout(bytes, align);
+        ::operator delete(p, b, std::align_val_t{a});
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& r) const noexcept override
+    {
+        return dynamic_cast<const aligned_memory_resource*>(&r) != nullptr;
+    }
 };
-/*
-template <typename S, int ... sizes_and_offsets>
-struct extracted_abs_sizes_impl
+
+/// @brief Resource used when no other is set, never destroyed so static matrices may outlive everything else.
+inline std::pmr::memory_resource* default_memory_resource() noexcept
+{
+    static aligned_memory_resource* r = new aligned_memory_resource{};
+    return r;
+}
+
+namespace impl {
+
+/// @brief Resource of the calling thread.
+inline std::pmr::memory_resource*& thread_memory_resource() noexcept
+{
+    thread_local std::pmr::memory_resource* r = default_memory_resource();
+    return r;
+}
+
+}
+
+/// @brief Resource owned matrices of the calling thread are allocated from.
+inline std::pmr::memory_resource* current_memory_resource() noexcept
+{
+    return impl::thread_memory_resource();
+}
+
+/// @brief Sets the resource of the calling thread, returns the previous one.
+inline std::pmr::memory_resource* set_memory_resource(std::pmr::memory_resource* r) noexcept
+{
+    assert(r != nullptr);
+    return std::exchange(impl::thread_memory_resource(), r);
+}
+
+/// @brief Sets the resource of the calling thread for the lifetime of the scope.
+class memory_resource_scope
 {
-    static constexpr inline auto value = array_from_sequence<S>::value;
+public:
+    explicit memory_resource_scope(std::pmr::memory_resource& r) noexcept
+        : previous_{set_memory_resource(&r)}
+    {
+    }
+
+    memory_resource_scope(const memory_resource_scope&) = delete;
+    memory_resource_scope& operator=(const memory_resource_scope&) = delete;
+
+    ~memory_resource_scope() noexcept
+    {
+        set_memory_resource(previous_);
+    }
+
+private:
+    std::pmr::memory_resource* previous_;
 };
 
-template <typename S, int abs_size, int abs_offset, int offset, int size, int ... tail>
-struct  extracted_abs_sizes_impl<S, abs_size, abs_offset, offset, size, tail ...> :
-    public extracted_abs_sizes_impl<typename integer_sequence_add_element<abs_size, S>::type, tail ...>
+namespace impl {
+
+/// @brief Pins the calling worker t of threads to its NUMA node.
+inline void pin_worker(int t) noexcept
+{
+#ifdef __linux__
+    if constexpr (numa_pinning) {
+        const auto& nodes = numa_nodes();
+        if (nodes.size() > 1) {
+            const auto& set = nodes[t * nodes.size() / threads];
+            ::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set_t), &set);
+        }
+    }
+#endif
+}
+
+/// @brief Runs f(start, end) over [0, count) split between threads, worker t taking the t-th contiguous part.
+/// Storage first touched by the same split is placed on the node of the worker that processes it. Workers allocate
+/// from the resource of the calling thread, which should then be thread safe.
+template <typename F>
+inline void parallel_for(int64_t count, const F& f) noexcept
+{
+    std::array<std::future<void>, threads> state;
+    std::pmr::memory_resource* r = current_memory_resource();
+    for (int t = 0; t < threads; ++t) {
+        state[t] = std::async(std::launch::async, [&f, r, t, count]() {
+                memory_resource_scope scope{*r};
+                pin_worker(t);
+                f(t * count / threads, (t + 1) * count / threads);
+            });
+    }
+    for (int t = 0; t < threads; ++t) {
+        state[t].get();
+    }
+}
+
+}
+
+/// @brief Tag of owned matrices left uninitialized, for outputs overwritten as a whole.
+struct uninitialized_t
 {
+    explicit uninitialized_t() = default;
 };
 
-template <typename S, int ... sizes_and_offsets>
-struct extracted_abs_offsets_impl
+inline constexpr uninitialized_t uninitialized{};
+
+/// @brief Size of an axis known only at runtime. Only axis 0 may be dynamic: matrixd<T, dynamic_extent, sizes ...>
+/// is a batch of matrixd<T, sizes ...> with the number of items given on construction.
+inline constexpr int dynamic_extent = -1;
+
+/// @brief NUMA placement of numa_memory_resource blocks: on the nodes of the workers that first touch each page,
+/// or interleaved page by page over all nodes.
+enum class numa_policy
 {
-    static constexpr inline auto value = array_from_sequence<S>::value;
+    first_touch,
+    interleave
 };
 
-template <typename S, int abs_size, int abs_offset, int offset, int size, int ... tail>
-struct  extracted_abs_offsets_impl<S, abs_size, abs_offset, offset, size, tail ...> :
-    public extracted_abs_offsets_impl<typename integer_sequence_add_element<abs_offset, S>::type, tail ...>
+/// @brief Memory resource placing large blocks on NUMA nodes by policy. Blocks of at least huge_page_bytes are
+/// mapped directly so no page is touched before the workers fill them, smaller ones come from the default resource.
+class numa_memory_resource : public std::pmr::memory_resource
 {
+public:
+    explicit numa_memory_resource(numa_policy policy = numa_policy::first_touch) noexcept
+        : policy_{policy}
+    {
+    }
+
+    numa_policy policy() const noexcept
+    {
+        return policy_;
+    }
+
+private:
+    static bool mapped(std::size_t bytes, std::size_t align) noexcept
+    {
+#ifdef __linux__
+        return bytes >= huge_page_bytes && align <= 4096;
+#else
+        return false;
+#endif
+    }
+
+    void* do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        if (!mapped(bytes, align)) {
+            return default_memory_resource()->allocate(bytes, align);
+        }
+#ifdef __linux__
+        void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            throw std::bad_alloc{};
+        }
+        const auto& nodes = impl::numa_nodes();
+        if (policy_ == numa_policy::interleave && nodes.size() > 1) {
+            constexpr int mpol_interleave = 3;
+            std::array<unsigned long, 16> mask{};
+            for (std::size_t n = 0; n < nodes.size() && n < mask.size() * 64; ++n) {
+                mask[n / 64] |= 1ul << (n % 64);
+            }
+            ::syscall(SYS_mbind, p, bytes, mpol_interleave, mask.data(), mask.size() * 64, 0);
+        }
+        if (huge_page_threshold != 0 && bytes >= huge_page_threshold) {
+            ::madvise(p, bytes, MADV_HUGEPAGE);
+        }
+        return p;
+#else
+        return default_memory_resource()->allocate(bytes, align);
+#endif
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t align) override
+    {
+        if (!mapped(bytes, align)) {
+            default_memory_resource()->deallocate(p, bytes, align);
+            return;
+        }
+#ifdef __linux__
+        ::munmap(p, bytes);
+#endif
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& r) const noexcept override
+    {
+        return this == &r;
+    }
+
+    numa_policy policy_;
 };
 
-template <typename S, int ... sizes_and_offsets>
-struct extracted_sizes_impl
+/// @brief Monotonic arena, everything allocated from it is released at once by release() or destruction.
+/// Allocation is thread safe so the workers of parallel_for may share it, release() is not.
+class arena : public std::pmr::monotonic_buffer_resource
 {
-    static constexpr inline auto value = array_from_sequence<S>::value;
+public:
+    explicit arena(std::size_t initial_size = std::size_t{1} << 20) noexcept
+        : std::pmr::monotonic_buffer_resource{initial_size, default_memory_resource()}
+    {
+    }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        std::lock_guard lock{mutex_};
+        return std::pmr::monotonic_buffer_resource::do_allocate(bytes, align);
+    }
+
+    std::mutex mutex_;
 };
 
-template <typename S, int abs_size, int abs_offset, int offset, int size, int ... tail>
-struct  extracted_sizes_impl<S, abs_size, abs_offset, offset, size, tail ...> :
-    public extracted_sizes_impl<typename integer_sequence_add_element<size, S>::type, tail ...>
+/// @brief Thread safe pool of size classes, reuses released blocks.
+class pool : public std::pmr::synchronized_pool_resource
 {
+public:
+    pool() noexcept
+        : std::pmr::synchronized_pool_resource{default_memory_resource()}
+    {
+    }
 };
 
-template <typename S, int ... sizes_and_offsets>
-struct extracted_offsets_impl
+/// @brief Header of matrix files, followed by the elements in row major order.
+struct file_header
 {
-    static constexpr inline auto value = array_from_sequence<S>::value;
+    std::array<char, 8> magic;
+    char kind;
+    uint8_t element_size;
+    char byte_order;
+    uint8_t dimensions;
+    uint32_t reserved;
+    std::array<int64_t, 6> sizes;
 };
 
-template <typename S, int abs_size, int abs_offset, int offset, int size, int ... tail>
-struct  extracted_offsets_impl<S, abs_size, abs_offset, offset, size, tail ...> :
-    public extracted_offsets_impl<typename integer_sequence_add_element<offset, S>::type, tail ...>
+static_assert(sizeof(file_header) == 64);
+
+static constexpr std::array<char, 8> file_magic = {'K', 'H', 'M', 'A', 'T', 'R', 'X', '1'};
+
+/// @brief How map_file maps the file: read only, private copy on write, shared writes, or shared writes to a
+/// file created with the matrix shape. Read only files are mapped privately as well, so writes through the mutable
+/// matrix never reach the file instead of faulting.
+enum class map_mode
 {
+    read_only,
+    copy_on_write,
+    shared,
+    create
 };
 
-template <int ... sizes_and_offsets>
-constexpr inline auto extracted_abs_sizes = extracted_abs_sizes_impl<std::integer_sequence<int>, sizes_and_offsets ...>::value;
+/// @brief Expected access pattern of a mapped file.
+enum class map_advice
+{
+    normal,
+    sequential,
+    random,
+    willneed
+};
 
-template <int ... sizes_and_offsets>
-constexpr inline auto extracted_abs_offsets = extracted_abs_offsets_impl<std::integer_sequence<int>, sizes_and_offsets ...>::value;
+namespace impl {
 
-template <int ... sizes_and_offsets>
-constexpr inline auto extracted_sizes = extracted_sizes_impl<std::integer_sequence<int>, sizes_and_offsets ...>::value;
+/// @brief Byte alignment requested for owned storage of elements of type T.
+template <typename T>
+constexpr inline std::size_t storage_alignment = std::max(alignment, alignof(T));
 
-template <int ... sizes_and_offsets>
-constexpr inline auto extracted_offsets = extracted_offsets_impl<std::integer_sequence<int>, sizes_and_offsets ...>::value;
-*/
+/// @brief Storage of small owned matrices inside the matrix object, empty for larger ones.
+template <typename T, int64_t count, bool enabled = count * sizeof(T) <= inline_bytes>
+struct inline_storage
+{
+    static constexpr inline std::size_t alignment = storage_alignment<T>;
+
+    constexpr T* data() const noexcept
+    {
+        return nullptr;
+    }
+};
+
+template <typename T, int64_t count>
+struct inline_storage<T, count, true>
+{
+    static constexpr inline std::size_t alignment =
+        std::max(alignof(T), std::min(storage_alignment<T>, std::bit_ceil(std::size_t(count * sizeof(T)))));
+
+    constexpr T* data() noexcept
+    {
+        return values.data();
+    }
+
+    constexpr const T* data() const noexcept
+    {
+        return values.data();
+    }
+
+    alignas(alignment) std::array<T, count> values;
+};
 
+/// @brief Allocates aligned storage of count elements from the memory resource, value initialized or, for
+/// storage about to be overwritten, default initialized.
+template <typename T, bool initialize = true>
+inline T* allocate(int64_t count, std::pmr::memory_resource* r) noexcept
+{
+    T* p = static_cast<T*>(r->allocate(count * sizeof(T), storage_alignment<T>));
+    if constexpr (initialize) {
+        if (count > crit_compl) {
+            parallel_for(count, [p](int64_t start, int64_t end) {
+                    std::uninitialized_value_construct_n(p + start, end - start);
+                });
+        } else {
+            std::uninitialized_value_construct_n(p, count);
+        }
+    } else {
+        std::uninitialized_default_construct_n(p, count);
+    }
+    return p;
 }
 
+/// @brief Releases storage obtained from allocate.
+template <typename T>
+inline void deallocate(T* p, int64_t count, std::pmr::memory_resource* r) noexcept
+{
+    std::destroy_n(p, count);
+    r->deallocate(p, count * sizeof(T), storage_alignment<T>);
 }
 
-namespace khustup {
+/// @brief Reference count of storage shared by several owned matrices.
+struct shared_block
+{
+    std::atomic<int64_t> count;
+};
 
-namespace impl {
+inline shared_block* make_shared_block(std::pmr::memory_resource* r) noexcept
+{
+    return new (r->allocate(sizeof(shared_block), alignof(shared_block))) shared_block{1};
+}
+
+inline void destroy_shared_block(shared_block* b, std::pmr::memory_resource* r) noexcept
+{
+    b->~shared_block();
+    r->deallocate(b, sizeof(shared_block), alignof(shared_block));
+}
 
 /// @brief Matrix declaration.
 template <typename T, int ... sizes_and_offsets>
 struct matrix_impl;
 
-/// @brief Matrix add axis type.
-template <int abs_size, int abs_offset, int offset, int size, typename M>
-struct matrix_add_0_axis_type;
+/// @brief Matrix view declaration.
+template <typename T, int ... sizes_and_offsets>
+struct matrix_view;
+
+/// @brief Declaration of matrices with a runtime size on axis 0.
+template <typename M>
+struct dynamic_matrix_impl;
+
+/// @brief Layout of a matrix type: its element type and the (abs_size, abs_offset, offset, size) quadruples.
+template <typename M>
+struct matrix_layout;
 
-template <typename T, int abs_size, int abs_offset, int offset, int size, int ... sizes_and_offsets>
-struct matrix_add_0_axis_type<abs_size, abs_offset, offset, size, matrix_impl<T, sizes_and_offsets ...>>
+template <typename T, int ... sizes_and_offsets>
+struct matrix_layout<matrix_impl<T, sizes_and_offsets ...>>
 {
-    using type = matrix_impl<T, sizes_and_offsets ..., abs_size, abs_offset, offset, size>;
+    using element_type = T;
+    static constexpr inline std::array<int, sizeof...(sizes_and_offsets)> value{sizes_and_offsets ...};
 };
 
-/// @brief Matrix remove first axis type.
-template <typename M>
-struct matrix_remove_0_axis_type;
+template <typename T, const auto& layout, std::size_t ... k>
+matrix_impl<T, layout[k] ...> layout_matrix(std::index_sequence<k ...>) noexcept;
+
+/// @brief Matrix type of a layout. Type computations transform layouts with constexpr functions and expand the
+/// result once, instead of rebuilding the matrix type axis by axis. The layout is passed by reference to a static
+/// constexpr array, as array values as template arguments are much slower to compile.
+template <typename T, const auto& layout>
+using layout_matrix_type = decltype(layout_matrix<T, layout>(std::make_index_sequence<layout.size()>{}));
+
+/// @brief Layout of the continuous matrix of the sizes: row major strides, nothing cropped.
+template <std::size_t n>
+constexpr std::array<int, 4 * n> continuous_layout(const std::array<int, n>& sizes) noexcept
+{
+    std::array<int, 4 * n> r{};
+    int stride = 1;
+    for (auto k = n; k-- > 0;) {
+        r[4 * k] = sizes[k];
+        r[4 * k + 1] = stride;
+        r[4 * k + 2] = 0;
+        r[4 * k + 3] = sizes[k];
+        if (k > 0) {
+            stride *= sizes[k];
+        }
+    }
+    return r;
+}
+
+/// @brief Layout without its first count axes.
+template <std::size_t count, std::size_t n>
+constexpr std::array<int, n - 4 * count> removed_axes_layout(const std::array<int, n>& layout) noexcept
+{
+    std::array<int, n - 4 * count> r{};
+    std::copy(layout.begin() + 4 * count, layout.end(), r.begin());
+    return r;
+}
+
+/// @brief Layout with the offsets of the leading axes moved and their sizes replaced.
+template <std::size_t n, std::size_t m>
+constexpr std::array<int, n> cropped_layout(std::array<int, n> layout, const std::array<int, m>& offsets_and_sizes) noexcept
+{
+    for (std::size_t k = 0; k < m / 2; ++k) {
+        layout[4 * k + 2] += offsets_and_sizes[2 * k];
+        layout[4 * k + 3] = offsets_and_sizes[2 * k + 1];
+    }
+    return layout;
+}
+
+/// @brief Layout of every step-th element of the leading axes, given (offset, size, step) triples relative to the
+/// offsets of the layout. Offsets that are not a multiple of their step are left to sliced_shift().
+template <std::size_t n, std::size_t m>
+constexpr std::array<int, n> sliced_layout(std::array<int, n> layout, const std::array<int, m>& slices) noexcept
+{
+    for (std::size_t k = 0; k < m / 3; ++k) {
+        const int offset = layout[4 * k + 2] + slices[3 * k];
+        const int step = slices[3 * k + 2];
+        layout[4 * k] = (layout[4 * k] - offset % step + step - 1) / step;
+        layout[4 * k + 1] *= step;
+        layout[4 * k + 2] = offset / step;
+        layout[4 * k + 3] = slices[3 * k + 1];
+    }
+    return layout;
+}
+
+/// @brief Raw offset of the first element of sliced_layout() not covered by its offsets.
+template <std::size_t n, std::size_t m>
+constexpr int64_t sliced_shift(const std::array<int, n>& layout, const std::array<int, m>& slices) noexcept
+{
+    int64_t r = 0;
+    for (std::size_t k = 0; k < m / 3; ++k) {
+        r += int64_t{(layout[4 * k + 2] + slices[3 * k]) % slices[3 * k + 2]} * layout[4 * k + 1];
+    }
+    return r;
+}
+
+/// @brief Whether every slice has a positive step and stays within the sizes of the layout.
+template <std::size_t n, std::size_t m>
+constexpr bool valid_slices(const std::array<int, n>& layout, const std::array<int, m>& slices) noexcept
+{
+    for (std::size_t k = 0; k < m / 3; ++k) {
+        const int offset = slices[3 * k];
+        const int size = slices[3 * k + 1];
+        const int step = slices[3 * k + 2];
+        if (step < 1 || offset < 0 || size < 0 || (size > 0 && offset + (size - 1) * step >= layout[4 * k + 3])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// @brief Raw offset of the first element of a layout.
+template <std::size_t n>
+constexpr int64_t layout_origin(const std::array<int, n>& layout) noexcept
+{
+    int64_t r = 0;
+    for (std::size_t k = 0; k < n / 4; ++k) {
+        r += int64_t{layout[4 * k + 2]} * layout[4 * k + 1];
+    }
+    return r;
+}
+
+/// @brief Strides that visit the elements of a layout in the same order with the new sizes, if there are any. Runs
+/// of axes merged or split by the new sizes have to be strided uniformly, as in a continuous matrix; axes of size 1
+/// don't matter.
+template <std::size_t n, std::size_t m>
+constexpr std::optional<std::array<int, m>> reshaped_strides(const std::array<int, n>& layout,
+                                                             const std::array<int, m>& new_sizes) noexcept
+{
+    std::array<int, n / 4> sizes{};
+    std::array<int, n / 4> strides{};
+    std::size_t d = 0;
+    for (std::size_t k = 0; k < n / 4; ++k) {
+        if (layout[4 * k + 3] != 1) {
+            sizes[d] = layout[4 * k + 3];
+            strides[d++] = layout[4 * k + 1];
+        }
+    }
+    if (layout_volume(layout) == 0) {
+        return std::nullopt;
+    }
+    std::array<int, m> r{};
+    std::size_t oi = 0;
+    std::size_t ni = 0;
+    while (oi < d && ni < m) {
+        std::size_t oj = oi + 1;
+        std::size_t nj = ni + 1;
+        int64_t op = sizes[oi];
+        int64_t np = new_sizes[ni];
+        while (op != np) {
+            if (np < op) {
+                np *= new_sizes[nj++];
+            } else {
+                op *= sizes[oj++];
+            }
+        }
+        for (auto k = oi; k + 1 < oj; ++k) {
+            if (strides[k] != int64_t{sizes[k + 1]} * strides[k + 1]) {
+                return std::nullopt;
+            }
+        }
+        r[nj - 1] = strides[oj - 1];
+        for (auto k = nj - 1; k > ni; --k) {
+            r[k - 1] = r[k] * new_sizes[k];
+        }
+        oi = oj;
+        ni = nj;
+    }
+    for (auto k = m; k-- > 0;) {
+        if (new_sizes[k] == 1) {
+            r[k] = k + 1 < m ? r[k + 1] * new_sizes[k + 1] : 1;
+        }
+    }
+    return r;
+}
+
+/// @brief Layout of the sizes and strides, nothing cropped.
+template <std::size_t m>
+constexpr std::array<int, 4 * m> strided_layout(const std::array<int, m>& sizes, const std::array<int, m>& strides) noexcept
+{
+    std::array<int, 4 * m> r{};
+    for (std::size_t k = 0; k < m; ++k) {
+        r[4 * k] = sizes[k];
+        r[4 * k + 1] = strides[k];
+        r[4 * k + 2] = 0;
+        r[4 * k + 3] = sizes[k];
+    }
+    return r;
+}
+
+/// @brief Layout with the quadruples of axes i and j exchanged.
+template <std::size_t n>
+constexpr std::array<int, n> swapped_axes_layout(std::array<int, n> layout, int i, int j) noexcept
+{
+    std::swap_ranges(layout.begin() + 4 * i, layout.begin() + 4 * i + 4, layout.begin() + 4 * j);
+    return layout;
+}
 
-template <typename T, int abs_size, int abs_offset, int offset, int size, int ... tail>
-struct matrix_remove_0_axis_type<matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>>
+/// @brief Matrix change element type.
+template <typename U, typename M>
+struct matrix_rebind_type;
+
+template <typename U, typename T, int ... sizes_and_offsets>
+struct matrix_rebind_type<U, matrix_impl<T, sizes_and_offsets ...>>
 {
-    using type = matrix_impl<T, tail ...>;
+    using type = matrix_impl<U, sizes_and_offsets ...>;
 };
 
-/// @brief Matrix change first axis type.
-template <int abs_size0, int abs_offset0, int offset0, int size0, typename M>
-struct matrix_set_0_axis_type;
+/// @brief View type of a matrix type, without instantiating the matrix.
+template <typename M>
+struct matrix_view_type;
 
-template <int abs_size0, int abs_offset0, int offset0, int size0,
-          typename T,
-          int abs_size, int abs_offset, int offset, int size,
-          int ... tail
-         >
-struct matrix_set_0_axis_type<abs_size0, abs_offset0, offset0, size0,
-                              matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>>
+template <typename T, int ... sizes_and_offsets>
+struct matrix_view_type<matrix_impl<T, sizes_and_offsets ...>>
 {
-    using type = matrix_impl<T, abs_size0, abs_offset0, offset0, size0, tail ...>;
+    using type = matrix_view<T, sizes_and_offsets ...>;
 };
 
 /// @brief Submatrix type.
 template <typename M, int index_count>
-struct submatrix_type :
-    public submatrix_type<typename matrix_remove_0_axis_type<M>::type, index_count - 1>
+struct submatrix_type
 {
+    static constexpr inline auto layout = removed_axes_layout<index_count>(matrix_layout<M>::value);
+    using type = layout_matrix_type<typename matrix_layout<M>::element_type, layout>;
 };
 
 template <typename M>
@@ -185,184 +787,82 @@ struct submatrix_type<M, 0>
 };
 
 /// @brief Continuous matrix type.
-template <typename T, typename M, int ... sizes>
+template <typename T, int ... sizes>
 struct continuous_matrix_type
 {
-    using type = M;
+    static constexpr inline auto layout = continuous_layout(std::array<int, sizeof...(sizes)>{sizes ...});
+    using type = layout_matrix_type<T, layout>;
 };
 
-template <typename T, typename M, int abs_size, int ... tail>
-struct continuous_matrix_type<T, M, abs_size, tail ...> :
-    public continuous_matrix_type<T, typename matrix_add_0_axis_type<abs_size,
-                                                                      product<tail ...>,
-                                                                      0,
-                                                                      abs_size,
-                                                                      M>::type, tail ...>
+template <typename M>
+struct continuous_matrix_type_from_matrixd
 {
+    static constexpr inline auto layout = continuous_layout(layout_field<3>(matrix_layout<M>::value));
+    using type = layout_matrix_type<typename matrix_layout<M>::element_type, layout>;
 };
 
-template <typename T, typename S>
-struct continuous_matrix_type_from_sequence;
-
-template <typename T, int ... abs_sizes>
-struct continuous_matrix_type_from_sequence<T, std::integer_sequence<int, abs_sizes ...>>
-{
-    using type = typename continuous_matrix_type<T, matrix_impl<T>, abs_sizes ...>::type;
-};
+template <typename M>
+using continuous_matrix_type_from_matrix = typename continuous_matrix_type_from_matrixd<M>::type;
 
-template <typename M, typename S>
-struct continuous_matrix_type_from_matrixd;
+/// @brief Continuous matrix type with element type R and the size of one axis replaced.
+template <typename R, int axis, int new_size, typename M, typename S = std::make_integer_sequence<int, M::dimensions>>
+struct resized_matrix_type;
 
-template <typename T, typename S, int abs_size, int abs_offset, int offset, int size, int ... tail>
-struct continuous_matrix_type_from_matrixd<matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>,
-                                           S> : public
-        continuous_matrix_type_from_matrixd<matrix_impl<T, tail ...>,
-                                            typename integer_sequence_add_element<size, S>::type>
+template <typename R, int axis, int new_size, typename M, int ... i>
+struct resized_matrix_type<R, axis, new_size, M, std::integer_sequence<int, i ...>>
 {
+    static_assert(axis >= 0 && axis < M::dimensions);
+    using type = typename continuous_matrix_type<R, (i == axis ? new_size : std::get<i>(M::sizes)) ...>::type;
 };
 
-template <typename T, typename S, int abs_size, int abs_offset, int offset, int size>
-struct continuous_matrix_type_from_matrixd<matrix_impl<T, abs_size, abs_offset, offset, size>, S>
+/// @brief Cropped matrix type: offsets relative to those of M and sizes of the leading axes.
+template <typename M, int ... offsets_and_sizes>
+struct cropped_matrix_type
 {
-    using type = typename continuous_matrix_type_from_sequence<T,
-                                                               typename integer_sequence_add_element<size,
-                                                                                            S>::type>::type;
+    static_assert(sizeof...(offsets_and_sizes) % 2 == 0);
+    static_assert(sizeof...(offsets_and_sizes) / 2 <= matrix_layout<M>::value.size() / 4);
+    static constexpr inline auto layout =
+        cropped_layout(matrix_layout<M>::value, std::array<int, sizeof...(offsets_and_sizes)>{offsets_and_sizes ...});
+    using type = layout_matrix_type<typename matrix_layout<M>::element_type, layout>;
 };
 
-template <typename M>
-using continuous_matrix_type_from_matrix = typename continuous_matrix_type_from_matrixd<M,
-                                                                            std::integer_sequence<int>>::type;
-
-/// @brief Cropped matrix type.
-template <typename M1, typename M2, int ... offsets_and_sizes>
-struct cropped_matrix_type
+/// @brief Strided slice type: (offset, size, step) of the leading axes. Its raw offsets start shift elements after
+/// those of M.
+template <typename M, int ... slices>
+struct sliced_matrix_type
 {
-    using type = M2;
+    static_assert(sizeof...(slices) % 3 == 0);
+    static_assert(sizeof...(slices) / 3 <= matrix_layout<M>::value.size() / 4);
+    static_assert(valid_slices(matrix_layout<M>::value, std::array<int, sizeof...(slices)>{slices ...}));
+    static constexpr inline auto layout =
+        sliced_layout(matrix_layout<M>::value, std::array<int, sizeof...(slices)>{slices ...});
+    static constexpr inline int64_t shift =
+        sliced_shift(matrix_layout<M>::value, std::array<int, sizeof...(slices)>{slices ...});
+    using type = layout_matrix_type<typename matrix_layout<M>::element_type, layout>;
 };
 
-template <typename M1, typename M2, int offset, int size, int ... tail>
-struct cropped_matrix_type<M1, M2, offset, size, tail ...> :
-    public cropped_matrix_type<typename matrix_remove_0_axis_type<M1>::type,
-                                    typename matrix_add_0_axis_type<std::get<0>(M1::absolute_sizes),
-                                                                    std::get<0>(M1::absolute_offsets),
-                                                                    std::get<0>(M1::offsets) + offset,
-                                                                    size,
-                                                                    M2>::type,
-                                    tail ...>
+/// @brief Matrix type of the elements of M in the same order with the new sizes, when it doesn't need a copy. Its raw
+/// offsets start shift elements after those of M.
+template <typename M, int ... sizes>
+struct reshaped_matrix_type
 {
+    static constexpr inline auto strides =
+        reshaped_strides(matrix_layout<M>::value, std::array<int, sizeof...(sizes)>{sizes ...});
+    static constexpr inline bool is_view = strides.has_value();
+    static constexpr inline auto layout =
+        strided_layout(std::array<int, sizeof...(sizes)>{sizes ...}, strides.value_or(std::array<int, sizeof...(sizes)>{}));
+    static constexpr inline int64_t shift = layout_origin(matrix_layout<M>::value);
+    using type = layout_matrix_type<typename matrix_layout<M>::element_type, layout>;
 };
 
 /// @brief Matrix swap axes type.
-template <int i, int abs_size0, int abs_offset0, int offset0, int size0, typename M1, typename M2>
-struct matrix_swap_axis_with_0_type_impl;
-
-template <int i,
-          int abs_size0,
-          int abs_offset0,
-          int offset0,
-          int size0,
-          typename M,
-          typename T,
-          int abs_size,
-          int abs_offset,
-          int offset,
-          int size,
-          int ... tail
-         >
-struct matrix_swap_axis_with_0_type_impl<i,
-                                         abs_size0,
-                                         abs_offset0,
-                                         offset0,
-                                         size0,
-                                         M,
-                                         matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>> :
-    public matrix_swap_axis_with_0_type_impl<i - 1,
-                                             abs_size0,
-                                             abs_offset0,
-                                             offset0,
-                                             size0,
-                                             typename matrix_add_0_axis_type<abs_size,
-                                                                             abs_offset,
-                                                                             offset,
-                                                                             size,
-                                                                             M>::type,
-                                             matrix_impl<T, tail ...>
-                                            >
-{
-};
-
-template <int abs_size0,
-          int abs_offset0,
-          int offset0,
-          int size0,
-          typename M,
-          typename T,
-          int abs_size,
-          int abs_offset,
-          int offset,
-          int size,
-          int ... tail
-         >
-struct matrix_swap_axis_with_0_type_impl<0,
-                                         abs_size0,
-                                         abs_offset0,
-                                         offset0,
-                                         size0,
-                                         M,
-                                         matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>> :
-    public matrix_swap_axis_with_0_type_impl<sizeof...(tail) / 4,
-                                             abs_size,
-                                             abs_offset,
-                                             offset,
-                                             size,
-                                             typename matrix_add_0_axis_type<abs_size0,
-                                                                             abs_offset0,
-                                                                             offset0,
-                                                                             size0,
-                                                                             M>::type,
-                                             matrix_impl<T, tail ...>
-                                            >
-{
-};
-
-template <int abs_size0, int abs_offset0, int offset0, int size0, typename M, typename T>
-struct matrix_swap_axis_with_0_type_impl<0, abs_size0, abs_offset0, offset0, size0, M, matrix_impl<T>>
-{
-    using type = typename matrix_set_0_axis_type<abs_size0, abs_offset0, offset0, size0,  M>::type;
-};
-
-template <int i, typename M>
-struct matrix_swap_axis_with_0_type;
-
-template <int i, typename T, int abs_size, int abs_offset, int offset, int size, int ... tail>
-struct matrix_swap_axis_with_0_type<i, matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>>
-{
-    static_assert(i >= 0 && i < sizeof...(tail) / 4 + 1);
-    using type = typename matrix_swap_axis_with_0_type_impl<i,
-                                                            abs_size,
-                                                            abs_offset,
-                                                            offset,
-                                                            size,
-                                                            matrix_impl<T>,
-                                                            matrix_impl<T,
-                                                                        abs_size,
-                                                                        abs_offset,
-                                                                        offset,
-                                                                        size,
-                                                                        tail ...>>::type;
-};
-
 template <int i, int j, typename M>
 struct matrix_swap_axes_type
 {
-private:
-    static constexpr inline int i_ = std::min(i, j);
-    static constexpr inline int j_ = std::max(i, j);
-
-public:
-    using type = typename matrix_swap_axis_with_0_type<i_,
-        typename matrix_swap_axis_with_0_type<j_,
-            typename matrix_swap_axis_with_0_type<i_, M>::type>::type>::type;
+    static_assert(i >= 0 && i < int(matrix_layout<M>::value.size() / 4));
+    static_assert(j >= 0 && j < int(matrix_layout<M>::value.size() / 4));
+    static constexpr inline auto layout = swapped_axes_layout(matrix_layout<M>::value, i, j);
+    using type = layout_matrix_type<typename matrix_layout<M>::element_type, layout>;
 };
 
 template <int i, typename M>
@@ -371,83 +871,102 @@ struct matrix_swap_axes_type<i, i, M>
     using type = M;
 };
 
-/// @brief Dot product matrix type.
-template <typename M1, typename M2, typename S>
-struct dot_product_matrix_type_impl :
-    public dot_product_matrix_type_impl<typename submatrix_type<M1, 1>::type,
-                                        typename submatrix_type<M2, 1>::type,
-                                        typename integer_sequence_add_element<std::max(std::get<0>(M1::sizes),
-                                                                                       std::get<0>(M2::sizes)),
-                                                                              S>::type>
-{
-    static_assert(std::tuple_size<decltype(M1::sizes)>::value != 2);
-    static constexpr inline auto s1 = std::get<0>(M1::sizes);
-    static constexpr inline auto s2 = std::get<0>(M2::sizes);
-    static_assert(s1 == s2 || s1 == 1 || s2 == 1);
-};
-
-template <typename T,
-          int abs_size11, int abs_offset11, int offset11, int size11,
-          int abs_size12, int abs_offset12, int offset12, int size12,
-          int abs_size21, int abs_offset21, int offset21, int size21,
-          int abs_size22, int abs_offset22, int offset22, int size22,
-          typename S>
-struct dot_product_matrix_type_impl<matrix_impl<T,
-                                                abs_size11, abs_offset11, offset11, size11,
-                                                abs_size12, abs_offset12, offset12, size12>,
-                                    matrix_impl<T,
-                                                abs_size21, abs_offset21, offset21, size21,
-                                                abs_size22, abs_offset22, offset22, size22>,
-                                    S>
-{
-    static_assert(size12 == size21);
-    using type = typename continuous_matrix_type_from_sequence<T,
-        typename integer_sequence_add_element<size22,
-        typename integer_sequence_add_element<size11,
-                                              S>::type
-                                                  >::type>::type;
-};
-
-template <typename M1, typename M2, bool is_square, bool first_is_one, bool second_is_one, bool async>
-struct dot_product_calculator
+/// @brief Sizes of the dot product of matrices of sizes s1 and s2: the leading axes broadcast, then the rows of
+/// the first and the columns of the second.
+template <std::size_t n>
+constexpr std::array<int, n> dot_product_sizes(const std::array<int, n>& s1, const std::array<int, n>& s2) noexcept
 {
-    using type = typename dot_product_matrix_type_impl<M1, M2, std::integer_sequence<int>>::type;
-    static constexpr int ss = std::get<0>(M1::sizes);
-    using S1 = typename M1::template submatrix_type<1>;
-    using S2 = typename M2::template submatrix_type<1>;
-    static constexpr bool s = std::tuple_size<decltype(S1::sizes)>::value == 2;
-    static constexpr bool s1 = std::get<0>(S1::sizes) == 1;
-    static constexpr bool s2 = std::get<0>(S2::sizes) == 1;
+    std::array<int, n> r{};
+    for (std::size_t k = 0; k + 2 < n; ++k) {
+        r[k] = std::max(s1[k], s2[k]);
+    }
+    r[n - 2] = s1[n - 2];
+    r[n - 1] = s2[n - 1];
+    return r;
+}
 
-    inline static void calculate(const M1& m1, const M2& m2, type& r) noexcept
-    {
-        if (async && ss >= threads) {
-            std::array<std::future<void>, threads> state;
-            for (int t = 0; t < threads; ++t) {
-                state[t] = std::async(std::launch::async, [&](int start, int end) {
-                    for (auto i = start; i < end; ++i) {
-                        auto rr = r[i];
-                        dot_product_calculator<S1, S2, s, s1, s2, false>::calculate(m1[i], m2[i], rr);
-                    }
-                }, t * ss / threads, (t + 1) * ss / threads);
-            }
-            for (int t = 0; t < threads; ++t) {
-                state[t].get();
-            }
+template <std::size_t n>
+constexpr bool broadcastable(const std::array<int, n>& s1, const std::array<int, n>& s2, std::size_t count) noexcept
+{
+    for (std::size_t k = 0; k < count; ++k) {
+        if (s1[k] != s2[k] && s1[k] != 1 && s2[k] != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// @brief Dot product matrix type.
+template <typename M1, typename M2>
+struct dot_product_matrix_type_impl
+{
+private:
+    using L1 = matrix_layout<M1>;
+    using L2 = matrix_layout<M2>;
+    using T = std::remove_const_t<typename L1::element_type>;
+    static_assert(std::is_same<T, std::remove_const_t<typename L2::element_type>>::value);
+    static_assert(L1::value.size() == L2::value.size() && L1::value.size() >= 8);
+    static constexpr inline auto s1 = layout_field<3>(L1::value);
+    static constexpr inline auto s2 = layout_field<3>(L2::value);
+    static_assert(s1[s1.size() - 1] == s2[s2.size() - 2]);
+    static_assert(broadcastable(s1, s2, s1.size() - 2));
+
+    static constexpr inline auto layout = continuous_layout(dot_product_sizes(s1, s2));
+
+public:
+    /// @brief Operands may be views of const elements, the product is writable.
+    using type = layout_matrix_type<T, layout>;
+};
+
+/// @brief Writes an element of a dot product, or adds it to the element when accumulating.
+template <bool accumulate, typename T, typename V>
+constexpr void dot_store(T&& r, const V& v) noexcept
+{
+    if constexpr (accumulate) {
+        r += v;
+    } else {
+        r = v;
+    }
+}
+
+template <typename M1, typename M2, bool is_square, bool first_is_one, bool second_is_one, bool async,
+          bool accumulate = false>
+struct dot_product_calculator
+{
+    using type = typename dot_product_matrix_type_impl<typename M1::matrix_type,
+                                                       typename M2::matrix_type>::type::view_type;
+    static constexpr int ss = std::get<0>(M1::sizes);
+    using S1 = typename M1::template submatrix_type<1>;
+    using S2 = typename M2::template submatrix_type<1>;
+    static constexpr bool s = std::tuple_size<decltype(S1::sizes)>::value == 2;
+    static constexpr bool s1 = std::get<0>(S1::sizes) == 1;
+    static constexpr bool s2 = std::get<0>(S2::sizes) == 1;
+
+    template <typename R>
+    inline static void calculate(const M1& m1, const M2& m2, R& r) noexcept
+    {
+        if (async && ss >= threads) {
+            parallel_for(ss, [&](int64_t start, int64_t end) {
+                for (auto i = start; i < end; ++i) {
+                    auto rr = r[i];
+                    dot_product_calculator<S1, S2, s, s1, s2, false, accumulate>::calculate(m1[i], m2[i], rr);
+                }
+            });
         }
         else {
             for (auto i = 0; i < ss; ++i) {
                 auto rr = r[i];
-                dot_product_calculator<S1, S2, s, s1, s2, async>::calculate(m1[i], m2[i], rr);
+                dot_product_calculator<S1, S2, s, s1, s2, async, accumulate>::calculate(m1[i], m2[i], rr);
             }
         }
     }
 };
 
-template <typename M1, typename M2, bool is_square, bool first_is_one, bool async>
-struct dot_product_calculator<M1, M2, is_square, first_is_one, true, async>
+template <typename M1, typename M2, bool is_square, bool first_is_one, bool async, bool accumulate>
+struct dot_product_calculator<M1, M2, is_square, first_is_one, true, async, accumulate>
 {
-    using type = typename dot_product_matrix_type_impl<M1, M2, std::integer_sequence<int>>::type;
+    using type = typename dot_product_matrix_type_impl<typename M1::matrix_type,
+                                                       typename M2::matrix_type>::type::view_type;
     static constexpr int ss = std::get<0>(M1::sizes);
     using S1 = typename M1::template submatrix_type<1>;
     using S2 = typename M2::template submatrix_type<1>;
@@ -455,35 +974,31 @@ struct dot_product_calculator<M1, M2, is_square, first_is_one, true, async>
     static constexpr bool s1 = std::get<0>(S1::sizes) == 1;
     static constexpr bool s2 = std::get<0>(S2::sizes) == 1;
 
-    inline static void calculate(const M1& m1, const M2& m2, type& r) noexcept
+    template <typename R>
+    inline static void calculate(const M1& m1, const M2& m2, R& r) noexcept
     {
         if (async && ss >= threads) {
-            std::array<std::future<void>, threads> state;
-            for (int t = 0; t < threads; ++t) {
-                state[t] = std::async(std::launch::async, [&](int start, int end) {
-                    for (auto i = start; i < end; ++i) {
-                        auto rr = r[i];
-                        dot_product_calculator<S1, S2, s, s1, s2, false>::calculate(m1[i], m2[0], rr);
-                    }
-                }, t * ss / threads, (t + 1) * ss / threads);
-            }
-            for (int t = 0; t < threads; ++t) {
-                state[t].get();
-            }
+            parallel_for(ss, [&](int64_t start, int64_t end) {
+                for (auto i = start; i < end; ++i) {
+                    auto rr = r[i];
+                    dot_product_calculator<S1, S2, s, s1, s2, false, accumulate>::calculate(m1[i], m2[0], rr);
+                }
+            });
         } 
         else {
             for (auto i = 0; i < ss; ++i) {
                 auto rr = r[i];
-                dot_product_calculator<S1, S2, s, s1, s2, async>::calculate(m1[i], m2[0], rr);
+                dot_product_calculator<S1, S2, s, s1, s2, async, accumulate>::calculate(m1[i], m2[0], rr);
             }
         }
     }
 };
 
-template <typename M1, typename M2, bool is_square, bool second_is_one, bool async>
-struct dot_product_calculator<M1, M2, is_square, true, second_is_one, async>
+template <typename M1, typename M2, bool is_square, bool second_is_one, bool async, bool accumulate>
+struct dot_product_calculator<M1, M2, is_square, true, second_is_one, async, accumulate>
 {
-    using type = typename dot_product_matrix_type_impl<M1, M2, std::integer_sequence<int>>::type;
+    using type = typename dot_product_matrix_type_impl<typename M1::matrix_type,
+                                                       typename M2::matrix_type>::type::view_type;
     static constexpr int ss = std::get<0>(M2::sizes);
     using S1 = typename M1::template submatrix_type<1>;
     using S2 = typename M2::template submatrix_type<1>;
@@ -491,277 +1006,1683 @@ struct dot_product_calculator<M1, M2, is_square, true, second_is_one, async>
     static constexpr bool s1 = std::get<0>(S1::sizes) == 1;
     static constexpr bool s2 = std::get<0>(S2::sizes) == 1;
 
-    inline static void calculate(const M1& m1, const M2& m2, type& r) noexcept
+    template <typename R>
+    inline static void calculate(const M1& m1, const M2& m2, R& r) noexcept
     {
         if (async && ss >= threads) {
-            std::array<std::future<void>, threads> state;
-            for (int t = 0; t < threads; ++t) {
-                state[t] = std::async(std::launch::async, [&](int start, int end) {
-                    for (auto i = start; i < end; ++i) {
-                        auto rr = r[i];
-                        dot_product_calculator<S1, S2, s, s1, s2, false>::calculate(m1[0], m2[i], rr);
-                    }
-                }, t * ss / threads, (t + 1) * ss / threads);
-            }
-            for (int t = 0; t < threads; ++t) {
-                state[t].get();
-            }
+            parallel_for(ss, [&](int64_t start, int64_t end) {
+                for (auto i = start; i < end; ++i) {
+                    auto rr = r[i];
+                    dot_product_calculator<S1, S2, s, s1, s2, false, accumulate>::calculate(m1[0], m2[i], rr);
+                }
+            });
         } 
         else {
             for (auto i = 0; i < ss; ++i) {
                 auto rr = r[i];
-                dot_product_calculator<S1, S2, s, s1, s2, async>::calculate(m1[0], m2[i], rr);
+                dot_product_calculator<S1, S2, s, s1, s2, async, accumulate>::calculate(m1[0], m2[i], rr);
             }
         }
     }
 };
 
-template <typename M1, typename M2, bool is_square, bool async>
-struct dot_product_calculator<M1, M2, is_square, true, true, async>
+template <typename M1, typename M2, bool is_square, bool async, bool accumulate>
+struct dot_product_calculator<M1, M2, is_square, true, true, async, accumulate>
 {
-    using type = typename dot_product_matrix_type_impl<M1, M2, std::integer_sequence<int>>::type;
+    using type = typename dot_product_matrix_type_impl<typename M1::matrix_type,
+                                                       typename M2::matrix_type>::type::view_type;
     using S1 = typename M1::template submatrix_type<1>;
     using S2 = typename M2::template submatrix_type<1>;
     static constexpr bool s = std::tuple_size<decltype(S1::sizes)>::value == 2;
     static constexpr bool s1 = std::get<0>(S1::sizes) == 1;
     static constexpr bool s2 = std::get<0>(S2::sizes) == 1;
 
-    inline static void calculate(const M1& m1, const M2& m2, type& r) noexcept
+    template <typename R>
+    inline static void calculate(const M1& m1, const M2& m2, R& r) noexcept
     {
         auto rr = r[0];
-        dot_product_calculator<S1, S2, s, s1, s2, async>::calculate(m1[0], m2[0], rr);
+        dot_product_calculator<S1, S2, s, s1, s2, async, accumulate>::calculate(m1[0], m2[0], rr);
     }
 };
 
-template <typename M1, typename M2, bool async>
-struct dot_product_calculator<M1, M2, true, false, false, async>
+template <typename M1, typename M2, bool async, bool accumulate>
+struct dot_product_calculator<M1, M2, true, false, false, async, accumulate>
 {
-    using type = typename dot_product_matrix_type_impl<M1, M2, std::integer_sequence<int>>::type;
+    using type = typename dot_product_matrix_type_impl<typename M1::matrix_type,
+                                                       typename M2::matrix_type>::type::view_type;
     static constexpr int s = std::get<1>(M1::sizes);
     static constexpr int s1 = std::get<0>(M1::sizes);
     static constexpr int s2 = std::get<1>(M2::sizes);
     static_assert(std::get<1>(M1::sizes) == std::get<0>(M2::sizes));
 
-    inline static void calculate(const M1& m1, const M2& m2, type& r) noexcept
+    template <typename R>
+    inline static void calculate(const M1& m1, const M2& m2, R& r) noexcept
     {
         if (async && s1 >= threads) {
-            std::array<std::future<void>, threads> state;
-            for (int t = 0; t < threads; ++t) {
-                state[t] = std::async(std::launch::async, [&](int start, int end) {
-                    for (auto i = start; i < end; ++i) {
-                        for (auto j = 0; j < s2; ++j) {
-                            for (auto k = 0; k < s; ++k) {
-                                r[i][j] += m1[i][k] * m2[k][j];
-                            }
-                        }
-                    }
-                }, t * s1 / threads, (t + 1) * s1 / threads);
-            }
-            for (int t = 0; t < threads; ++t) {
-                state[t].get();
-            }
+            parallel_for(s1, [&](int64_t start, int64_t end) {
+                calculate_rows(m1, m2, r, static_cast<int>(start), static_cast<int>(end));
+            });
         }
         else if (async && s2 >= threads) {
-            std::array<std::future<void>, threads> state;
-            for (int t = 0; t < threads; ++t) {
-                state[t] = std::async(std::launch::async, [&](int start, int end) {
-                    for (auto i = 0; i < s1; ++i) {
-                        for (auto j = start; j < end; ++j) {
-                            for (auto k = 0; k < s; ++k) {
-                                r[i][j] += m1[i][k] * m2[k][j];
-                            }
+            parallel_for(s2, [&](int64_t start, int64_t end) {
+                for (auto i = 0; i < s1; ++i) {
+                    for (auto j = start; j < end; ++j) {
+                        typename type::value_type acc{};
+                        for (auto k = 0; k < s; ++k) {
+                            acc += m1[i][k] * m2[k][j];
                         }
+                        dot_store<accumulate>(r[i][j], acc);
                     }
-                }, t * s2 / threads, (t + 1) * s2 / threads);
-            }
-            for (int t = 0; t < threads; ++t) {
-                state[t].get();
-            }
+                }
+            });
         }
         else {
-            for (auto i = 0; i < s1; ++i) {
+            calculate_rows(m1, m2, r, 0, s1);
+        }
+    }
+
+private:
+    using V = typename type::value_type;
+    /// @brief Rows and columns of the blocks of r, sized to stay in registers.
+    static constexpr int ib = 2;
+    static constexpr int jb = std::min<int>(s2, 4 * vector_bytes / sizeof(V));
+    /// @brief Whether to scale rows of m2, products with a small m2 vectorize better as unrolled dot products of
+    /// rows and columns.
+    static constexpr bool by_rows = s * s2 * sizeof(V) > 1024;
+
+    template <typename R>
+    inline static void calculate_rows(const M1& m1, const M2& m2, R& r, int start, int end) noexcept
+    {
+        if constexpr (by_rows) {
+            int j0 = 0;
+            for (; j0 + jb <= s2; j0 += jb) {
+                calculate_panel<jb>(m1, m2, r, start, end, j0);
+            }
+            if constexpr (s2 % jb != 0) {
+                calculate_panel<s2 % jb>(m1, m2, r, start, end, j0);
+            }
+        } else {
+            for (auto i = start; i < end; ++i) {
                 for (auto j = 0; j < s2; ++j) {
+                    V acc{};
                     for (auto k = 0; k < s; ++k) {
-                        r[i][j] += m1[i][k] * m2[k][j];
+                        acc += m1[i][k] * m2[k][j];
                     }
+                    dot_store<accumulate>(r[i][j], acc);
+                }
+            }
+        }
+    }
+
+    /// The n columns of m2 from j0 stay in cache while the rows of r are computed.
+    template <int n, typename R>
+    inline static void calculate_panel(const M1& m1, const M2& m2, R& r, int start, int end, int j0) noexcept
+    {
+        int i = start;
+        for (; i + ib <= end; i += ib) {
+            calculate_block<ib, n>(m1, m2, r, i, j0);
+        }
+        for (; i < end; ++i) {
+            calculate_block<1, n>(m1, m2, r, i, j0);
+        }
+    }
+
+    /// Rows of m2 are scaled into a (rows, n) block of r kept in a local buffer: the inner loop is contiguous and
+    /// doesn't alias the operands, and each row of m2 loaded serves all rows of the block.
+    template <int rows, int n, typename R>
+    inline static void calculate_block(const M1& m1, const M2& m2, R& r, int i, int j0) noexcept
+    {
+        std::array<V, rows * n> acc;
+        for (int q = 0; q < rows; ++q) {
+            for (int j = 0; j < n; ++j) {
+                acc[q * n + j] = accumulate ? V{r[i + q][j0 + j]} : V{};
+            }
+        }
+        for (int k = 0; k < s; ++k) {
+            const auto b = m2[k];
+            for (int q = 0; q < rows; ++q) {
+                const V a = m1[i + q][k];
+                for (int j = 0; j < n; ++j) {
+                    acc[q * n + j] += a * b[j0 + j];
                 }
             }
         }
+        for (int q = 0; q < rows; ++q) {
+            for (int j = 0; j < n; ++j) {
+                r[i + q][j0 + j] = acc[q * n + j];
+            }
+        }
     }
 };
 
-template <typename M1, typename M2, bool async>
-struct dot_product_calculator<M1, M2, true, true, false, async>
+template <typename M1, typename M2, bool async, bool accumulate>
+struct dot_product_calculator<M1, M2, true, true, false, async, accumulate>
 {
-    using type = typename dot_product_matrix_type_impl<M1, M2, std::integer_sequence<int>>::type;
+    using type = typename dot_product_matrix_type_impl<typename M1::matrix_type,
+                                                       typename M2::matrix_type>::type::view_type;
     static constexpr int s = std::get<1>(M1::sizes);
     static constexpr int s1 = std::get<0>(M1::sizes);
     static constexpr int s2 = std::get<1>(M2::sizes);
     static_assert(std::get<1>(M1::sizes) == std::get<0>(M2::sizes));
 
-    inline static void calculate(const M1& m1, const M2& m2, type& r) noexcept
+    template <typename R>
+    inline static void calculate(const M1& m1, const M2& m2, R& r) noexcept
     {
         if (async && s2 >= threads) {
-            std::array<std::future<void>, threads> state;
-            for (int t = 0; t < threads; ++t) {
-                state[t] = std::async(std::launch::async, [&](int start, int end) {
-                    for (auto j = start; j < end; ++j) {
-                        for (auto k = 0; k < s; ++k) {
-                            r[0][j] += m1[0][k] * m2[k][j];
-                        }
+            parallel_for(s2, [&](int64_t start, int64_t end) {
+                for (auto j = start; j < end; ++j) {
+                    typename type::value_type acc{};
+                    for (auto k = 0; k < s; ++k) {
+                        acc += m1[0][k] * m2[k][j];
                     }
-                }, t * s2 / threads, (t + 1) * s2 / threads);
-            }
-            for (int t = 0; t < threads; ++t) {
-                state[t].get();
-            }
+                    dot_store<accumulate>(r[0][j], acc);
+                }
+            });
         }
         else {
             for (auto j = 0; j < s2; ++j) {
+                typename type::value_type acc{};
                 for (auto k = 0; k < s; ++k) {
-                    r[0][j] += m1[0][k] * m2[k][j];
+                    acc += m1[0][k] * m2[k][j];
                 }
+                dot_store<accumulate>(r[0][j], acc);
             }
         }
     }
 };
 
-template <typename M1, typename M2, bool async>
-struct dot_product_calculator<M1, M2, true, false, true, async>
+template <typename M1, typename M2, bool async, bool accumulate>
+struct dot_product_calculator<M1, M2, true, false, true, async, accumulate>
 {
-    using type = typename dot_product_matrix_type_impl<M1, M2, std::integer_sequence<int>>::type;
+    using type = typename dot_product_matrix_type_impl<typename M1::matrix_type,
+                                                       typename M2::matrix_type>::type::view_type;
     static constexpr int s = std::get<1>(M1::sizes);
     static constexpr int s1 = std::get<0>(M1::sizes);
     static constexpr int s2 = std::get<1>(M2::sizes);
     static_assert(std::get<1>(M1::sizes) == std::get<0>(M2::sizes));
 
-    inline static void calculate(const M1& m1, const M2& m2, type& r) noexcept
+    template <typename R>
+    inline static void calculate(const M1& m1, const M2& m2, R& r) noexcept
     {
         if (async && s1 >= threads) {
-            std::array<std::future<void>, threads> state;
-            for (int t = 0; t < threads; ++t) {
-                state[t] = std::async(std::launch::async, [&](int start, int end) {
-                    for (auto i = start; i < end; ++i) {
-                        for (auto j = 0; j < s2; ++j) {
-                            r[i][j] += m1[i][0] * m2[0][j];
-                        }
+            parallel_for(s1, [&](int64_t start, int64_t end) {
+                for (auto i = start; i < end; ++i) {
+                    for (auto j = 0; j < s2; ++j) {
+                        dot_store<accumulate>(r[i][j], m1[i][0] * m2[0][j]);
                     }
-                }, t * s1 / threads, (t + 1) * s1 / threads);
-            }
-            for (int t = 0; t < threads; ++t) {
-                state[t].get();
-            }
+                }
+            });
         }
         else if (async && s2 >= threads) {
-            std::array<std::future<void>, threads> state;
-            for (int t = 0; t < threads; ++t) {
-                state[t] = std::async(std::launch::async, [&](int start, int end) {
-                    for (auto i = 0; i < s1; ++i) {
-                        for (auto j = start; j < end; ++j) {
-                            r[i][j] += m1[i][0] * m2[0][j];
-                        }
+            parallel_for(s2, [&](int64_t start, int64_t end) {
+                for (auto i = 0; i < s1; ++i) {
+                    for (auto j = start; j < end; ++j) {
+                        dot_store<accumulate>(r[i][j], m1[i][0] * m2[0][j]);
                     }
-                }, t * s2 / threads, (t + 1) * s2 / threads);
-            }
-            for (int t = 0; t < threads; ++t) {
-                state[t].get();
-            }
+                }
+            });
         }
         else {
             for (auto i = 0; i < s1; ++i) {
                 for (auto j = 0; j < s2; ++j) {
-                    r[i][j] += m1[i][0] * m2[0][j];
+                    dot_store<accumulate>(r[i][j], m1[i][0] * m2[0][j]);
                 }
             }
         }
     }
 };
 
-template <typename M1, typename M2, bool async>
-struct dot_product_calculator<M1, M2, true, true, true, async>
+template <typename M1, typename M2, bool async, bool accumulate>
+struct dot_product_calculator<M1, M2, true, true, true, async, accumulate>
 {
-    using type = typename dot_product_matrix_type_impl<M1, M2, std::integer_sequence<int>>::type;
+    using type = typename dot_product_matrix_type_impl<typename M1::matrix_type,
+                                                       typename M2::matrix_type>::type::view_type;
     static constexpr int s = std::get<1>(M1::sizes);
     static constexpr int s1 = std::get<0>(M1::sizes);
     static constexpr int s2 = std::get<1>(M2::sizes);
     static_assert(std::get<1>(M1::sizes) == std::get<0>(M2::sizes));
 
-    inline static void calculate(const M1& m1, const M2& m2, type& r) noexcept
+    template <typename R>
+    inline static void calculate(const M1& m1, const M2& m2, R& r) noexcept
     {
         if (async && s2 >= threads) {
-            std::array<std::future<void>, threads> state;
-            for (int t = 0; t < threads; ++t) {
-                state[t] = std::async(std::launch::async, [&](int start, int end) {
-                    for (auto j = start; j < end; ++j) {
-                        r[0][j] += m1[0][0] * m2[0][j];
-                    }
-                }, t * s2 / threads, (t + 1) * s2 / threads);
-            }
-            for (int t = 0; t < threads; ++t) {
-                state[t].get();
-            }
+            parallel_for(s2, [&](int64_t start, int64_t end) {
+                for (auto j = start; j < end; ++j) {
+                    dot_store<accumulate>(r[0][j], m1[0][0] * m2[0][j]);
+                }
+            });
         }
         else {
             for (auto j = 0; j < s2; ++j) {
-                r[0][j] += m1[0][0] * m2[0][j];
+                dot_store<accumulate>(r[0][j], m1[0][0] * m2[0][j]);
             }
         }
     }
 };
 
+/// @brief Dot product of the matrices written into r, or added to r when accumulating. r has the sizes of their dot
+/// product type, its strides may differ.
+template <bool async, bool accumulate = false, typename M1, typename M2, typename R>
+inline void dot_into(const M1& m1, const M2& m2, R&& r) noexcept
+{
+    using V1 = typename M1::const_view_type;
+    using V2 = typename M2::const_view_type;
+    constexpr bool s1 = std::get<0>(V1::sizes) == 1;
+    constexpr bool s2 = std::get<0>(V2::sizes) == 1;
+    using D = dot_product_calculator<V1, V2, V1::dimensions == 2, s1, s2, async, accumulate>;
+    typename std::remove_cvref_t<R>::view_type v = r;
+    static_assert(decltype(v)::sizes == D::type::sizes);
+    D::calculate(m1, m2, v);
+}
+
+template <std::size_t n>
+constexpr std::array<int, n> max_sizes(const std::array<int, n>& s1, const std::array<int, n>& s2) noexcept
+{
+    std::array<int, n> r{};
+    for (std::size_t k = 0; k < n; ++k) {
+        r[k] = std::max(s1[k], s2[k]);
+    }
+    return r;
+}
+
 /// @brief Max possible size matrix type.
-template <typename M1, typename M2, typename S>
-struct max_size_matrix_type_impl :
-    public max_size_matrix_type_impl<typename submatrix_type<M1, 1>::type,
-                                        typename submatrix_type<M2, 1>::type,
-                                        typename integer_sequence_add_element<std::max(std::get<0>(M1::sizes),
-                                                                                       std::get<0>(M2::sizes)),
-                                                                              S>::type>
+template <typename M1, typename M2>
+struct max_size_matrix_type_impl
 {
+private:
+    using L1 = matrix_layout<M1>;
+    using L2 = matrix_layout<M2>;
+    static_assert(L1::value.size() == L2::value.size());
+    static constexpr inline auto s1 = layout_field<3>(L1::value);
+    static constexpr inline auto s2 = layout_field<3>(L2::value);
+    static constexpr inline auto layout = continuous_layout(max_sizes(s1, s2));
+
+public:
+    using type = layout_matrix_type<std::common_type_t<typename L1::element_type, typename L2::element_type>, layout>;
 };
 
-template <typename T,
-          int abs_size1, int abs_offset1, int offset1, int size1,
-          int abs_size2, int abs_offset2, int offset2, int size2,
-          typename S>
-struct max_size_matrix_type_impl<matrix_impl<T,
-                                                abs_size1, abs_offset1, offset1, size1>,
-                                    matrix_impl<T,
-                                                abs_size2, abs_offset2, offset2, size2>,
-                                    S>
+/// @brief Random access iterator over the elements of a non continuous matrix M in row major order. The raw offset
+/// of an element is decomposed from its flat index with the compile time sizes and strides of M.
+template <typename M, typename T>
+struct strided_iterator
 {
-    using type = typename continuous_matrix_type_from_sequence<T,
-        typename integer_sequence_add_element<std::max(size1, size2),
-                                              S>::type
-                                                  >::type;
+    using iterator_category = std::random_access_iterator_tag;
+    using iterator_concept = std::random_access_iterator_tag;
+    using value_type = std::remove_const_t<T>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T*;
+    using reference = T&;
+
+    constexpr strided_iterator() noexcept = default;
+
+    constexpr strided_iterator(T* data, difference_type index) noexcept
+        : data_{data}
+        , index_{index}
+    {
+    }
+
+    /// @brief Mutable iterators convert to const ones.
+    template <typename U>
+        requires std::is_same<const U, T>::value && (!std::is_same<U, T>::value)
+    constexpr strided_iterator(const strided_iterator<M, U>& i) noexcept
+        : data_{i.data_}
+        , index_{i.index_}
+    {
+    }
+
+    constexpr reference operator*() const noexcept
+    {
+        return data_[raw_offset(index_)];
+    }
+
+    constexpr pointer operator->() const noexcept
+    {
+        return data_ + raw_offset(index_);
+    }
+
+    constexpr reference operator[](difference_type n) const noexcept
+    {
+        return data_[raw_offset(index_ + n)];
+    }
+
+    constexpr strided_iterator& operator++() noexcept
+    {
+        ++index_;
+        return *this;
+    }
+
+    constexpr strided_iterator operator++(int) noexcept
+    {
+        auto r = *this;
+        ++index_;
+        return r;
+    }
+
+    constexpr strided_iterator& operator--() noexcept
+    {
+        --index_;
+        return *this;
+    }
+
+    constexpr strided_iterator operator--(int) noexcept
+    {
+        auto r = *this;
+        --index_;
+        return r;
+    }
+
+    constexpr strided_iterator& operator+=(difference_type n) noexcept
+    {
+        index_ += n;
+        return *this;
+    }
+
+    constexpr strided_iterator& operator-=(difference_type n) noexcept
+    {
+        index_ -= n;
+        return *this;
+    }
+
+    friend constexpr strided_iterator operator+(strided_iterator i, difference_type n) noexcept
+    {
+        return i += n;
+    }
+
+    friend constexpr strided_iterator operator+(difference_type n, strided_iterator i) noexcept
+    {
+        return i += n;
+    }
+
+    friend constexpr strided_iterator operator-(strided_iterator i, difference_type n) noexcept
+    {
+        return i -= n;
+    }
+
+    friend constexpr difference_type operator-(const strided_iterator& a, const strided_iterator& b) noexcept
+    {
+        return a.index_ - b.index_;
+    }
+
+    friend constexpr bool operator==(const strided_iterator& a, const strided_iterator& b) noexcept
+    {
+        return a.index_ == b.index_;
+    }
+
+    friend constexpr auto operator<=>(const strided_iterator& a, const strided_iterator& b) noexcept
+    {
+        return a.index_ <=> b.index_;
+    }
+
+    template <typename M1, typename U>
+    friend struct strided_iterator;
+
+private:
+    static constexpr inline auto sizes = std::apply([](auto ... s) {
+            return std::array<difference_type, sizeof...(s)>{s ...};
+        }, M::sizes);
+    static constexpr inline auto offsets = std::apply([](auto ... s) {
+            return std::array<difference_type, sizeof...(s)>{s ...};
+        }, M::offsets);
+    static constexpr inline auto strides = std::apply([](auto ... s) {
+            return std::array<difference_type, sizeof...(s)>{s ...};
+        }, M::absolute_offsets);
+
+    static constexpr difference_type raw_offset(difference_type index) noexcept
+    {
+        difference_type o = 0;
+        for (auto k = M::dimensions; k-- > 0;) {
+            o += (index % sizes[k] + offsets[k]) * strides[k];
+            index /= sizes[k];
+        }
+        return o;
+    }
+
+    T* data_ = nullptr;
+    difference_type index_ = 0;
 };
 
+/// @brief Index of the broadcast element along the first axis.
 template <typename M>
-struct sqrt_calculator
+constexpr inline int broadcast_index(int i) noexcept
+{
+    return std::get<0>(M::sizes) == 1 ? 0 : i;
+}
+
+/// @brief Element-wise calculator over several matrices.
+/// Axes of size 1 are broadcast, as in the arithmetic operators. When all matrices are continuous and of equal
+/// sizes the elements are visited by a single flat loop.
+template <bool async, typename ... Ms>
+struct element_wise_calculator
+{
+    static constexpr int size = std::max({std::get<0>(Ms::sizes) ...});
+    static constexpr int dimensions = std::max({Ms::dimensions ...});
+    static constexpr int64_t volume = std::max({Ms::volume ...});
+    static constexpr bool flat = (Ms::is_continuous && ...) &&
+                                 ((Ms::sizes == std::tuple_element_t<0, std::tuple<Ms ...>>::sizes) && ...);
+    static_assert(((Ms::dimensions == dimensions) && ...));
+    static_assert(((std::get<0>(Ms::sizes) == size || std::get<0>(Ms::sizes) == 1) && ...));
+
+    template <typename F, typename ... Ns>
+    inline static void calculate(const F& f, Ns&& ... ms) noexcept
+    {
+        if constexpr (flat) {
+            const auto body = [&f, &ms ...](int64_t start, int64_t end) {
+                calculate_flat(f, start, end, ms.data() ...);
+            };
+            if (async && volume >= threads) {
+                parallel_for(volume, body);
+            } else {
+                body(0, volume);
+            }
+        } else if constexpr (dimensions == 1) {
+            for (auto i = 0; i < size; ++i) {
+                f(ms[broadcast_index<Ms>(i)] ...);
+            }
+        } else if (async && size >= threads) {
+            parallel_for(size, [&f, &ms ...](int64_t start, int64_t end) {
+                for (auto i = static_cast<int>(start); i < end; ++i) {
+                    element_wise_calculator<false, typename Ms::template submatrix_type<1> ...>::calculate(
+                        f, ms[broadcast_index<Ms>(i)] ...);
+                }
+            });
+        } else {
+            for (auto i = 0; i < size; ++i) {
+                element_wise_calculator<async, typename Ms::template submatrix_type<1> ...>::calculate(
+                    f, ms[broadcast_index<Ms>(i)] ...);
+            }
+        }
+    }
+
+private:
+    template <typename F, typename ... P>
+    inline static void calculate_flat(const F& f, int64_t start, int64_t end, P* ... ps) noexcept
+    {
+        for (auto i = start; i < end; ++i) {
+            f(ps[i] ...);
+        }
+    }
+};
+
+/// @brief Applies f element-wise over the matrices, in parallel for big volumes.
+template <typename F, typename ... Ms>
+inline void element_wise(const F& f, Ms&& ... ms) noexcept
+{
+    constexpr int64_t v = std::max({std::remove_cvref_t<Ms>::volume ...});
+    element_wise_calculator<(v > crit_compl), std::remove_cvref_t<Ms> ...>::calculate(f, std::forward<Ms>(ms) ...);
+}
+
+/// @brief Element-wise calculator which also passes the element indices.
+template <typename M, bool async>
+struct indexed_calculator
 {
-    inline static constexpr void calculate(M& m)
+    static constexpr int size = std::get<0>(M::sizes);
+    using S = typename M::template submatrix_type<1>;
+
+    template <typename F, typename N, typename ... I>
+    inline static void calculate(const F& f, N&& m, I ... indices) noexcept
     {
-        for (auto i = 0; i < std::get<0>(M::sizes); ++i) {
-            auto mm = m[i];
-            sqrt_calculator<typename M::template submatrix_type<1>>::calculate(mm);
+        if (async && size >= threads) {
+            parallel_for(size, [&](int64_t start, int64_t end) {
+                for (auto i = static_cast<int>(start); i < end; ++i) {
+                    indexed_calculator<S, false>::calculate(f, m[i], indices ..., i);
+                }
+            });
+        } else {
+            for (auto i = 0; i < size; ++i) {
+                indexed_calculator<S, async>::calculate(f, m[i], indices ..., i);
+            }
         }
     }
 };
 
-template <typename T, int abs_size, int abs_offset, int offset, int size>
-struct sqrt_calculator<matrix_impl<T, abs_size, abs_offset, offset, size>>
+template <typename T, int abs_size, int abs_offset, int offset, int size, bool async>
+struct indexed_calculator<matrix_view<T, abs_size, abs_offset, offset, size>, async>
 {
-    inline static constexpr void calculate(matrix_impl<T, abs_size, abs_offset, offset, size>& m)
+    template <typename F, typename N, typename ... I>
+    inline static void calculate(const F& f, N&& m, I ... indices) noexcept
     {
         for (auto i = 0; i < size; ++i) {
-            m[i] = std::sqrt(m[i]);
+            f(m[i], indices ..., i);
         }
     }
 };
 
-/// @brief Continuous matrix type.
-template <typename T, int ... sizes>
-using continuous_matrixd = typename continuous_matrix_type<T, matrix_impl<T>, sizes ...>::type;
+/// @brief Matrix check.
+template <typename M>
+constexpr inline bool is_matrix = false;
+
+template <typename T, int ... sizes_and_offsets>
+constexpr inline bool is_matrix<matrix_impl<T, sizes_and_offsets ...>> = true;
+
+template <typename T, int ... sizes_and_offsets>
+constexpr inline bool is_matrix<matrix_view<T, sizes_and_offsets ...>> = true;
+
+/// @brief Check of matrices with a runtime size on axis 0.
+template <typename M>
+constexpr inline bool is_dynamic_matrix = false;
+
+template <typename M>
+constexpr inline bool is_dynamic_matrix<dynamic_matrix_impl<M>> = true;
+
+/// @brief Element type of a matrix or a scalar.
+template <typename M, bool = is_matrix<M>>
+struct element_type
+{
+    using type = M;
+};
+
+template <typename M>
+struct element_type<M, true>
+{
+    using type = typename M::value_type;
+};
+
+/// @brief Continuous matrix type with element type R broadcast from all matrices.
+template <typename R, typename ... Ms>
+struct broadcast_matrix_type;
+
+template <typename R, typename M>
+struct broadcast_matrix_type<R, M>
+{
+    using type = continuous_matrix_type_from_matrix<typename matrix_rebind_type<R, typename M::matrix_type>::type>;
+};
+
+template <typename R, typename M1, typename M2, typename ... Ms>
+struct broadcast_matrix_type<R, M1, M2, Ms ...> :
+    public broadcast_matrix_type<R,
+                                 typename max_size_matrix_type_impl<typename M1::matrix_type,
+                                                                    typename M2::matrix_type>::type,
+                                 Ms ...>
+{
+};
+
+/// @brief Sizes of matrices joined along the axis, the other sizes must be the same.
+template <int axis, std::size_t n, typename ... A>
+constexpr std::optional<std::array<int, n>> concat_sizes(std::array<int, n> sizes, const A& ... others) noexcept
+{
+    if (((others.size() != n) || ...)) {
+        return std::nullopt;
+    }
+    for (std::size_t k = 0; k < n; ++k) {
+        if (k != axis && ((others[k] != sizes[k]) || ...)) {
+            return std::nullopt;
+        }
+    }
+    ((sizes[axis] += others[axis]), ...);
+    return sizes;
+}
+
+/// @brief Continuous matrix type with element type R of the matrices joined along the axis.
+template <int axis, typename R, typename M, typename ... Ms>
+struct concat_matrix_type
+{
+    static constexpr inline auto sizes = concat_sizes<axis>(layout_field<3>(matrix_layout<typename M::matrix_type>::value),
+                                                            layout_field<3>(matrix_layout<typename Ms::matrix_type>::value) ...);
+    static_assert(axis >= 0 && axis < M::dimensions);
+    static_assert(sizes.has_value(), "Matrices differ in sizes other than along the axis");
+    static constexpr inline auto layout = continuous_layout(sizes.value_or(std::array<int, M::dimensions>{}));
+    using type = layout_matrix_type<R, layout>;
+};
+
+/// @brief View of the matrix with an axis of size 1 inserted before the given one.
+template <int axis, typename M, std::size_t ... k>
+constexpr auto inserted_axis_view(const M& m, std::index_sequence<k ...>) noexcept
+{
+    constexpr auto s = layout_field<3>(matrix_layout<typename M::matrix_type>::value);
+    return m.template reshape<(k < axis ? s[k] : k == axis ? 1 : s[k - 1]) ...>();
+}
+
+/// @brief Crop of dst of the sizes of M, starting at offset along the axis.
+template <int axis, int offset, typename M, typename D, std::size_t ... k>
+constexpr auto axis_crop(D& dst, std::index_sequence<k ...>) noexcept
+{
+    return dst.template crop<(k % 2 == 0 ? (k / 2 == axis ? offset : 0) : std::get<k / 2>(M::sizes)) ...>();
+}
+
+/// @brief Assigns the matrices to consecutive crops of dst along the axis, from offset on.
+template <int axis, int offset, typename D, typename M, typename ... Ms>
+constexpr void concat_assign(D& dst, const M& m, const Ms& ... ms) noexcept
+{
+    axis_crop<axis, offset, M>(dst, std::make_index_sequence<2 * M::dimensions>{}) = m;
+    if constexpr (sizeof...(Ms) > 0) {
+        concat_assign<axis, offset + std::get<axis>(M::sizes)>(dst, ms ...);
+    }
+}
+
+/// @brief Copy of a matrix converted and broadcast into the matrix type R.
+template <typename R, typename M>
+constexpr R promoted_copy(const M& m) noexcept
+{
+    if constexpr (std::is_same<R, typename M::continuous_matrix_type>::value) {
+        return m.copy();
+    } else {
+        R r{uninitialized};
+        r = m;
+        return r;
+    }
+}
+
+/// @brief Element conversion, optionally saturating to the range of U.
+template <typename U, bool saturate, typename T>
+constexpr inline U converted(const T& v) noexcept
+{
+    if constexpr (!saturate || !std::is_arithmetic<T>::value || !std::is_arithmetic<U>::value ||
+                  std::is_same<T, bool>::value || std::is_same<U, bool>::value) {
+        return static_cast<U>(v);
+    } else if constexpr (std::is_integral<U>::value && std::is_floating_point<T>::value) {
+        constexpr U lo = std::numeric_limits<U>::min();
+        constexpr U hi = std::numeric_limits<U>::max();
+        return v != v ? U{0} : (v <= static_cast<T>(lo) ? lo : (v >= static_cast<T>(hi) ? hi : static_cast<U>(v)));
+    } else if constexpr (std::is_integral<U>::value) {
+        constexpr U lo = std::numeric_limits<U>::min();
+        constexpr U hi = std::numeric_limits<U>::max();
+        return std::cmp_less(v, lo) ? lo : (std::cmp_greater(v, hi) ? hi : static_cast<U>(v));
+    } else if constexpr (std::is_floating_point<T>::value && sizeof(T) > sizeof(U)) {
+        constexpr T lo = static_cast<T>(std::numeric_limits<U>::lowest());
+        constexpr T hi = static_cast<T>(std::numeric_limits<U>::max());
+        return static_cast<U>(v < lo ? lo : (v > hi ? hi : v));
+    } else {
+        return static_cast<U>(v);
+    }
+}
+
+/// @brief Element type conversion calculator.
+template <typename M1, typename M2, bool saturate, bool continuous = M1::is_continuous && M2::is_continuous>
+struct cast_calculator
+{
+    inline static void calculate(const M1& m1, M2& m2) noexcept
+    {
+        for (auto i = 0; i < std::get<0>(M1::sizes); ++i) {
+            auto mm = m2[i];
+            cast_calculator<typename M1::template submatrix_type<1>,
+                            typename M2::template submatrix_type<1>,
+                            saturate>::calculate(m1[i], mm);
+        }
+    }
+};
+
+template <typename T, int abs_size1, int abs_offset1, int offset1, int size1,
+          typename U, int abs_size2, int abs_offset2, int offset2, int size2,
+          bool saturate>
+struct cast_calculator<matrix_view<T, abs_size1, abs_offset1, offset1, size1>,
+                       matrix_view<U, abs_size2, abs_offset2, offset2, size2>,
+                       saturate,
+                       false>
+{
+    inline static void calculate(const matrix_view<T, abs_size1, abs_offset1, offset1, size1>& m1,
+                                 matrix_view<U, abs_size2, abs_offset2, offset2, size2>& m2) noexcept
+    {
+        for (auto i = 0; i < size1; ++i) {
+            m2[i] = converted<U, saturate>(m1[i]);
+        }
+    }
+};
+
+/// Both sides are continuous, so conversion is a single flat loop which the compiler vectorizes.
+template <typename M1, typename M2, bool saturate>
+struct cast_calculator<M1, M2, saturate, true>
+{
+    inline static void calculate(const M1& m1, M2& m2) noexcept
+    {
+        using U = std::remove_cv_t<std::remove_reference_t<decltype(*m2.data())>>;
+        const auto* s = m1.data();
+        auto* d = m2.data();
+        for (int64_t i = 0; i < M1::volume; ++i) {
+            d[i] = converted<U, saturate>(s[i]);
+        }
+    }
+};
+
+/// @brief Product of the sizes of the axes [begin, end).
+template <typename M>
+constexpr inline int64_t sizes_product(int begin, int end) noexcept
+{
+    return std::apply([begin, end](auto ... s) {
+            int64_t v = 1;
+            int i = 0;
+            ((v *= (i >= begin && i < end) ? s : 1, ++i), ...);
+            return v;
+        }, M::sizes);
+}
+
+/// @brief Identity element of a scan operation.
+template <typename Op, typename T>
+struct scan_identity;
+
+template <typename U, typename T>
+struct scan_identity<std::plus<U>, T>
+{
+    static constexpr inline T value = T{0};
+};
+
+template <typename U, typename T>
+struct scan_identity<std::multiplies<U>, T>
+{
+    static constexpr inline T value = T{1};
+};
+
+/// @brief Inclusive scan of continuous data seen as (outer, n, inner) along the n axis.
+template <typename T, int64_t outer, int n, int64_t inner, bool async>
+struct scan_calculator
+{
+    template <typename Op>
+    inline static void calculate(T* p, const Op& op) noexcept
+    {
+        if (async && outer >= threads) {
+            parallel_for(outer, [&](int64_t start, int64_t end) {
+                for (auto o = start; o < end; ++o) {
+                    scan_rows(p + o * n * inner, 0, n, op);
+                }
+            });
+        } else if (async && n >= 2 * threads) {
+            // Two passes over blocks of the axis: local scans, then the carry of the previous blocks.
+            for (int64_t o = 0; o < outer; ++o) {
+                auto* q = p + o * n * inner;
+                parallel_for(n, [&](int64_t start, int64_t end) {
+                    scan_rows(q, start, end, op);
+                });
+                for (int t = 1; t < threads; ++t) {
+                    combine_row(q + ((t * n / threads) - 1) * inner, q + (((t + 1) * n / threads) - 1) * inner, op);
+                }
+                parallel_for(n, [&](int64_t start, int64_t end) {
+                    for (auto k = start; start != 0 && k < end - 1; ++k) {
+                        combine_row(q + (start - 1) * inner, q + k * inner, op);
+                    }
+                });
+            }
+        } else {
+            for (int64_t o = 0; o < outer; ++o) {
+                scan_rows(p + o * n * inner, 0, n, op);
+            }
+        }
+    }
+
+private:
+    template <typename Op>
+    inline static void combine_row(const T* c, T* r, const Op& op) noexcept
+    {
+        for (int64_t j = 0; j < inner; ++j) {
+            r[j] = op(c[j], r[j]);
+        }
+    }
+
+    template <typename Op>
+    inline static void scan_rows(T* q, int64_t start, int64_t end, const Op& op) noexcept
+    {
+        if constexpr (inner == 1) {
+            scan_contiguous(q + start, end - start, op);
+        } else {
+            // The axis is strided, whole rows are combined so the loop runs across slices.
+            for (auto k = start + 1; k < end; ++k) {
+                combine_row(q + (k - 1) * inner, q + k * inner, op);
+            }
+        }
+    }
+
+    template <typename Op>
+    inline static void scan_contiguous(T* q, int64_t count, const Op& op) noexcept
+    {
+        // Blocks of one vector width are scanned in register by log2(w) shifted steps.
+        constexpr int w = std::max<int>(2, vector_bytes / sizeof(T));
+        int64_t i = 0;
+        for (; i + w <= count; i += w) {
+            std::array<T, w> b;
+            std::copy(q + i, q + i + w, b.begin());
+            for (int s = 1; s < w; s *= 2) {
+                for (int j = w - 1; j >= s; --j) {
+                    b[j] = op(b[j - s], b[j]);
+                }
+            }
+            if (i > 0) {
+                const T c = q[i - 1];
+                for (int j = 0; j < w; ++j) {
+                    b[j] = op(c, b[j]);
+                }
+            }
+            std::copy(b.begin(), b.end(), q + i);
+        }
+        for (i = std::max<int64_t>(i, 1); i < count; ++i) {
+            q[i] = op(q[i - 1], q[i]);
+        }
+    }
+};
+
+/// @brief Scan of a continuous matrix in place along the axis.
+template <int axis, bool inclusive, typename M, typename Op>
+inline void scan_along(M& m, const Op& op) noexcept
+{
+    using T = typename M::value_type;
+    static_assert(M::is_continuous);
+    static_assert(axis >= 0 && axis < M::dimensions);
+    constexpr int n = std::get<axis>(M::sizes);
+    constexpr int64_t outer = sizes_product<M>(0, axis);
+    constexpr int64_t inner = sizes_product<M>(axis + 1, M::dimensions);
+    auto* p = m.data();
+    scan_calculator<T, outer, n, inner, (M::volume > crit_compl)>::calculate(p, op);
+    if constexpr (!inclusive) {
+        for (int64_t o = 0; o < outer; ++o) {
+            auto* q = p + o * n * inner;
+            std::copy_backward(q, q + (n - 1) * inner, q + n * inner);
+            std::fill(q, q + inner, scan_identity<Op, T>::value);
+        }
+    }
+}
+
+/// @brief Top k selection over continuous data seen as (outer, n, inner) along the n axis.
+template <typename T, int64_t outer, int n, int64_t inner, int k, bool async>
+struct topk_calculator
+{
+    static_assert(k > 0 && k <= n);
+
+    template <typename Compare>
+    inline static void calculate(const T* p, T* v, int* x, const Compare& comp) noexcept
+    {
+        const auto body = [&](int64_t start, int64_t end) {
+            for (auto s = start; s < end; ++s) {
+                const auto o = s / inner;
+                const auto j = s % inner;
+                select(p + o * n * inner + j, v + o * k * inner + j, x + o * k * inner + j, comp);
+            }
+        };
+        if (async && outer * inner >= threads) {
+            parallel_for(outer * inner, body);
+        } else {
+            body(0, outer * inner);
+        }
+    }
+
+private:
+    template <typename Compare>
+    inline static void select(const T* q, T* v, int* x, const Compare& comp) noexcept
+    {
+        using E = std::pair<T, int>;
+        const auto better = [&comp](const E& a, const E& b) {
+            return comp(a.first, b.first) || (!comp(b.first, a.first) && a.second < b.second);
+        };
+        // Heap with the worst of the selected elements on top, its value is the threshold for the rest.
+        std::array<E, k> heap;
+        for (int i = 0; i < k; ++i) {
+            heap[i] = E{q[i * inner], i};
+        }
+        std::make_heap(heap.begin(), heap.end(), better);
+        constexpr int w = std::max<int>(1, vector_bytes / sizeof(T));
+        for (int i = k; i < n; i += w) {
+            const int e = std::min(i + w, n);
+            const T t = heap.front().first;
+            bool any = false;
+            for (int j = i; j < e; ++j) {
+                any |= comp(q[j * inner], t);
+            }
+            if (!any) {
+                continue;
+            }
+            for (int j = i; j < e; ++j) {
+                if (comp(q[j * inner], heap.front().first)) {
+                    std::pop_heap(heap.begin(), heap.end(), better);
+                    heap.back() = E{q[j * inner], j};
+                    std::push_heap(heap.begin(), heap.end(), better);
+                }
+            }
+        }
+        std::sort_heap(heap.begin(), heap.end(), better);
+        for (int r = 0; r < k; ++r) {
+            v[r * inner] = heap[r].first;
+            x[r * inner] = heap[r].second;
+        }
+    }
+};
+
+/// @brief Best k elements and their indices along the axis, ordered best first.
+template <int axis, int k, typename M, typename Compare>
+inline auto topk_along(const M& m, const Compare& comp) noexcept
+{
+    using T = typename M::value_type;
+    if constexpr (!M::is_continuous) {
+        return topk_along<axis, k>(m.copy(), comp);
+    } else {
+        constexpr int n = std::get<axis>(M::sizes);
+        constexpr int64_t outer = sizes_product<M>(0, axis);
+        constexpr int64_t inner = sizes_product<M>(axis + 1, M::dimensions);
+        using V = typename resized_matrix_type<T, axis, k, M>::type;
+        using I = typename resized_matrix_type<int, axis, k, M>::type;
+        std::pair<V, I> r{std::piecewise_construct, std::forward_as_tuple(uninitialized), std::forward_as_tuple(uninitialized)};
+        topk_calculator<T, outer, n, inner, k, (M::volume > crit_compl)>::calculate(m.data(),
+                                                                                    r.first.data(),
+                                                                                    r.second.data(),
+                                                                                    comp);
+        return r;
+    }
+}
+
+/// @brief Philox4x32-10 counter-based generator: random bits of the element k under the seed.
+constexpr inline std::array<uint32_t, 4> philox(uint64_t k, uint64_t seed) noexcept
+{
+    std::array<uint32_t, 4> c{static_cast<uint32_t>(k), static_cast<uint32_t>(k >> 32), 0u, 0u};
+    uint32_t k0 = static_cast<uint32_t>(seed);
+    uint32_t k1 = static_cast<uint32_t>(seed >> 32);
+    for (int r = 0; r < 10; ++r) {
+        const uint64_t p0 = uint64_t{0xD2511F53u} * c[0];
+        const uint64_t p1 = uint64_t{0xCD9E8D57u} * c[2];
+        c = {static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k0,
+             static_cast<uint32_t>(p1),
+             static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k1,
+             static_cast<uint32_t>(p0)};
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    return c;
+}
+
+/// @brief Fills the matrix from the distribution.
+/// Every element draws from its own counter, the row-major index, so the result does not depend on the
+/// number of threads or on the memory layout.
+template <typename M, typename D>
+inline void random_fill(M& m, uint64_t seed, const D& d) noexcept
+{
+    using T = typename M::value_type;
+    if constexpr (M::is_continuous) {
+        auto* p = m.data();
+        const auto body = [p, seed, &d](int64_t start, int64_t end) {
+            for (auto k = start; k < end; ++k) {
+                p[k] = static_cast<T>(d(philox(static_cast<uint64_t>(k), seed)));
+            }
+        };
+        if (M::volume > crit_compl) {
+            parallel_for(M::volume, body);
+        } else {
+            body(0, M::volume);
+        }
+    } else {
+        constexpr auto sizes = std::apply([](auto ... s) { return std::array<int64_t, sizeof...(s)>{s ...}; },
+                                          M::sizes);
+        m.for_each_indexed([seed, &d, &sizes](T& v, auto ... indices) {
+                const std::array<int64_t, sizeof...(indices)> i{indices ...};
+                int64_t k = 0;
+                for (std::size_t a = 0; a < i.size(); ++a) {
+                    k = k * sizes[a] + i[a];
+                }
+                v = static_cast<T>(d(philox(static_cast<uint64_t>(k), seed)));
+            });
+    }
+}
+
+/// @brief Valid 2D cross-correlation of (batch, C, H, W) input with (F, C, KH, KW) kernels.
+/// Small kernels are computed directly, several outputs of a row at once in registers. Bigger ones run as a GEMM
+/// of the kernels with an implicit im2col matrix on the dot product kernels: for every kernel tap, a block of
+/// filters times the (C, OW) patch of an output row, read in place from the input, is added to the output rows.
+template <typename T, int C, int H, int W, int F, int KH, int KW, int sh, int sw, bool async>
+struct convolution_calculator
+{
+    static_assert(KH <= H && KW <= W && sh > 0 && sw > 0);
+    static constexpr int OH = (H - KH) / sh + 1;
+    static constexpr int OW = (W - KW) / sw + 1;
+    static constexpr bool direct = C * KH * KW <= 32;
+    static constexpr int ob = std::max<int>(1, vector_bytes / sizeof(T));
+    static constexpr int fb = std::min(F, 8);
+    static constexpr int fblocks = (F + fb - 1) / fb;
+
+    inline static void calculate(const T* in, const T* k, T* out, int batch) noexcept
+    {
+        const int64_t items = int64_t{batch} * (direct ? F : fblocks);
+        const auto body = [&](int64_t start, int64_t end) {
+            for (auto item = start; item < end; ++item) {
+                if constexpr (direct) {
+                    const auto n = item / F;
+                    const auto f = item % F;
+                    calculate_direct(in + n * C * H * W, k + f * C * KH * KW, out + item * OH * OW);
+                } else {
+                    const auto n = item / fblocks;
+                    const auto f = static_cast<int>(item % fblocks) * fb;
+                    const T* i = in + n * C * H * W;
+                    if constexpr (F % fb == 0) {
+                        calculate_gemm<fb>(i, k + f * C * KH * KW, out + (n * F + f) * OH * OW);
+                    } else if (f + fb <= F) {
+                        calculate_gemm<fb>(i, k + f * C * KH * KW, out + (n * F + f) * OH * OW);
+                    } else {
+                        calculate_gemm<F % fb>(i, k + f * C * KH * KW, out + (n * F + f) * OH * OW);
+                    }
+                }
+            }
+        };
+        if (async && items >= threads) {
+            parallel_for(items, body);
+        } else {
+            body(0, items);
+        }
+    }
+
+private:
+    template <int count>
+    inline static void direct_block(const T* in, const T* k, T* out) noexcept
+    {
+        std::array<T, count> acc{};
+        for (int c = 0; c < C; ++c) {
+            for (int kh = 0; kh < KH; ++kh) {
+                for (int kw = 0; kw < KW; ++kw) {
+                    const T w = k[(c * KH + kh) * KW + kw];
+                    const T* r = in + (c * H + kh) * W + kw;
+                    for (int j = 0; j < count; ++j) {
+                        acc[j] += w * r[j * sw];
+                    }
+                }
+            }
+        }
+        std::copy(acc.begin(), acc.end(), out);
+    }
+
+    inline static void calculate_direct(const T* in, const T* k, T* out) noexcept
+    {
+        for (int oh = 0; oh < OH; ++oh) {
+            const T* row = in + oh * sh * W;
+            int ow = 0;
+            for (; ow + ob <= OW; ow += ob) {
+                direct_block<ob>(row + ow * sw, k, out + oh * OW + ow);
+            }
+            for (; ow < OW; ++ow) {
+                direct_block<1>(row + ow * sw, k, out + oh * OW + ow);
+            }
+        }
+    }
+
+    /// The kernels of a tap are a (filters, C) view, the patch a (C, OW) view and the output rows a (filters, OW)
+    /// view, the first tap writes them and the others add to them.
+    template <int filters>
+    inline static void calculate_gemm(const T* in, const T* k, T* out) noexcept
+    {
+        using KV = matrix_view<const T, filters, C * KH * KW, 0, filters, C, KH * KW, 0, C>;
+        using PV = matrix_view<const T, C, H * W, 0, C, OW, sw, 0, OW>;
+        using OV = matrix_view<T, filters, OH * OW, 0, filters, OW, 1, 0, OW>;
+        for (int oh = 0; oh < OH; ++oh) {
+            T* o = out + oh * OW;
+            OV ov{o, o + OV::absolute_volume};
+            for (int kh = 0; kh < KH; ++kh) {
+                for (int kw = 0; kw < KW; ++kw) {
+                    const T* kk = k + kh * KW + kw;
+                    const T* p = in + (oh * sh + kh) * W + kw;
+                    const KV kv{kk, kk + KV::absolute_volume};
+                    const PV pv{p, p + PV::absolute_volume};
+                    if (kh == 0 && kw == 0) {
+                        dot_into<false>(kv, pv, ov);
+                    } else {
+                        dot_into<false, true>(kv, pv, ov);
+                    }
+                }
+            }
+        }
+    }
+};
+
+/// @brief Shape of a batch of (count, n, n) systems with (count, n, m) right hand sides.
+template <typename A, typename B = void>
+struct system_shape
+{
+    static_assert(A::dimensions == 2 || A::dimensions == 3);
+    static constexpr int d = A::dimensions - 2;
+    static constexpr int count = d == 1 ? std::get<0>(A::sizes) : 1;
+    static constexpr int n = std::get<d>(A::sizes);
+    static_assert(n == std::get<d + 1>(A::sizes), "Matrices should be square");
+    static constexpr int m = []() {
+        if constexpr (std::is_void<B>::value) {
+            return 0;
+        } else {
+            static_assert(B::dimensions == A::dimensions - 1 || B::dimensions == A::dimensions);
+            static_assert(d == 0 || std::get<0>(B::sizes) == count);
+            static_assert(std::get<d>(B::sizes) == n);
+            if constexpr (B::dimensions == A::dimensions) {
+                return std::get<d + 1>(B::sizes);
+            } else {
+                return 1;
+            }
+        }
+    }();
+};
+
+/// @brief Batched dense solvers on continuous (count, n, n) systems.
+/// Full groups of vector width systems are interleaved, element (i, j) of the l-th system is at
+/// (i * n + j) * L + l, so every scalar step of the algorithms runs as one vector operation over L systems.
+/// The remaining systems are solved one by one in place (L = 1). Singular or not positive definite systems
+/// give inf or nan in their results.
+template <typename T, int n, int m, bool async>
+struct solver_calculator
+{
+    static constexpr int lanes = std::max<int>(1, vector_bytes / sizeof(T));
+
+    inline static void lu(T* a, int* p, int64_t count) noexcept
+    {
+        batch(count, [a, p](int64_t first, auto l) {
+                constexpr int L = decltype(l)::value;
+                if constexpr (L == 1) {
+                    lu_kernel<1>(a + first * n * n, p + first * n);
+                } else {
+                    std::array<T, n * n * L> ia;
+                    std::array<int, n * L> ip;
+                    interleave<n * n, L>(a + first * n * n, ia.data());
+                    lu_kernel<L>(ia.data(), ip.data());
+                    deinterleave<n * n, L>(ia.data(), a + first * n * n);
+                    deinterleave<n, L>(ip.data(), p + first * n);
+                }
+            });
+    }
+
+    inline static void cholesky(T* a, int64_t count) noexcept
+    {
+        batch(count, [a](int64_t first, auto l) {
+                constexpr int L = decltype(l)::value;
+                if constexpr (L == 1) {
+                    cholesky_kernel<1>(a + first * n * n);
+                } else {
+                    std::array<T, n * n * L> ia;
+                    interleave<n * n, L>(a + first * n * n, ia.data());
+                    cholesky_kernel<L>(ia.data());
+                    deinterleave<n * n, L>(ia.data(), a + first * n * n);
+                }
+            });
+    }
+
+    template <bool lower, bool unit>
+    inline static void trsm(const T* a, T* b, int64_t count) noexcept
+    {
+        batch(count, [a, b](int64_t first, auto l) {
+                constexpr int L = decltype(l)::value;
+                if constexpr (L == 1) {
+                    trsm_kernel<1, lower, unit>(a + first * n * n, b + first * n * m);
+                } else {
+                    std::array<T, n * n * L> ia;
+                    std::array<T, n * m * L> ib;
+                    interleave<n * n, L>(a + first * n * n, ia.data());
+                    interleave<n * m, L>(b + first * n * m, ib.data());
+                    trsm_kernel<L, lower, unit>(ia.data(), ib.data());
+                    deinterleave<n * m, L>(ib.data(), b + first * n * m);
+                }
+            });
+    }
+
+    inline static void solve(T* a, T* b, int64_t count) noexcept
+    {
+        batch(count, [a, b](int64_t first, auto l) {
+                constexpr int L = decltype(l)::value;
+                std::array<T, n * n * L> ia;
+                std::array<T, n * m * L> ib;
+                std::array<int, n * L> ip;
+                interleave<n * n, L>(a + first * n * n, ia.data());
+                interleave<n * m, L>(b + first * n * m, ib.data());
+                lu_kernel<L>(ia.data(), ip.data());
+                for (int k = 0; k < n; ++k) {
+                    for (int l = 0; l < L; ++l) {
+                        const int r = ip[k * L + l];
+                        for (int c = 0; r != k && c < m; ++c) {
+                            std::swap(ib[(k * m + c) * L + l], ib[(r * m + c) * L + l]);
+                        }
+                    }
+                }
+                trsm_kernel<L, true, true>(ia.data(), ib.data());
+                trsm_kernel<L, false, false>(ia.data(), ib.data());
+                deinterleave<n * m, L>(ib.data(), b + first * n * m);
+            });
+    }
+
+private:
+    template <typename G>
+    inline static void batch(int64_t count, const G& group) noexcept
+    {
+        const int64_t groups = count / lanes;
+        const auto body = [&group](int64_t start, int64_t end) {
+            for (auto g = start; g < end; ++g) {
+                group(g * lanes, std::integral_constant<int, lanes>{});
+            }
+        };
+        if (async && groups >= threads) {
+            parallel_for(groups, body);
+        } else {
+            body(0, groups);
+        }
+        for (auto i = groups * lanes; i < count; ++i) {
+            group(i, std::integral_constant<int, 1>{});
+        }
+    }
+
+    template <int size, int L, typename E>
+    inline static void interleave(const E* s, E* d) noexcept
+    {
+        for (int l = 0; l < L; ++l) {
+            for (int e = 0; e < size; ++e) {
+                d[e * L + l] = s[l * size + e];
+            }
+        }
+    }
+
+    template <int size, int L, typename E>
+    inline static void deinterleave(const E* s, E* d) noexcept
+    {
+        for (int l = 0; l < L; ++l) {
+            for (int e = 0; e < size; ++e) {
+                d[l * size + e] = s[e * L + l];
+            }
+        }
+    }
+
+    template <int L>
+    inline static void lu_kernel(T* a, int* p) noexcept
+    {
+        const auto at = [a](int i, int j) { return a + (i * n + j) * L; };
+        for (int k = 0; k < n; ++k) {
+            std::array<int, L> pivot;
+            std::array<T, L> best;
+            for (int l = 0; l < L; ++l) {
+                pivot[l] = k;
+                best[l] = std::abs(at(k, k)[l]);
+            }
+            for (int i = k + 1; i < n; ++i) {
+                for (int l = 0; l < L; ++l) {
+                    const T v = std::abs(at(i, k)[l]);
+                    pivot[l] = v > best[l] ? i : pivot[l];
+                    best[l] = v > best[l] ? v : best[l];
+                }
+            }
+            for (int l = 0; l < L; ++l) {
+                p[k * L + l] = pivot[l];
+                for (int j = 0; pivot[l] != k && j < n; ++j) {
+                    std::swap(at(k, j)[l], at(pivot[l], j)[l]);
+                }
+            }
+            for (int i = k + 1; i < n; ++i) {
+                for (int l = 0; l < L; ++l) {
+                    at(i, k)[l] /= at(k, k)[l];
+                }
+                for (int j = k + 1; j < n; ++j) {
+                    for (int l = 0; l < L; ++l) {
+                        at(i, j)[l] -= at(i, k)[l] * at(k, j)[l];
+                    }
+                }
+            }
+        }
+    }
+
+    template <int L>
+    inline static void cholesky_kernel(T* a) noexcept
+    {
+        const auto at = [a](int i, int j) { return a + (i * n + j) * L; };
+        for (int j = 0; j < n; ++j) {
+            for (int k = 0; k < j; ++k) {
+                for (int l = 0; l < L; ++l) {
+                    at(j, j)[l] -= at(j, k)[l] * at(j, k)[l];
+                }
+            }
+            for (int l = 0; l < L; ++l) {
+                at(j, j)[l] = std::sqrt(at(j, j)[l]);
+            }
+            for (int i = j + 1; i < n; ++i) {
+                for (int k = 0; k < j; ++k) {
+                    for (int l = 0; l < L; ++l) {
+                        at(i, j)[l] -= at(i, k)[l] * at(j, k)[l];
+                    }
+                }
+                for (int l = 0; l < L; ++l) {
+                    at(i, j)[l] /= at(j, j)[l];
+                    at(j, i)[l] = T{0};
+                }
+            }
+        }
+    }
+
+    template <int L, bool lower, bool unit>
+    inline static void trsm_kernel(const T* a, T* b) noexcept
+    {
+        const auto at = [a](int i, int j) { return a + (i * n + j) * L; };
+        const auto bt = [b](int i, int c) { return b + (i * m + c) * L; };
+        for (int r = 0; r < n; ++r) {
+            const int i = lower ? r : n - 1 - r;
+            for (int c = 0; c < m; ++c) {
+                for (int k = lower ? 0 : i + 1; k < (lower ? i : n); ++k) {
+                    for (int l = 0; l < L; ++l) {
+                        bt(i, c)[l] -= at(i, k)[l] * bt(k, c)[l];
+                    }
+                }
+                for (int l = 0; !unit && l < L; ++l) {
+                    bt(i, c)[l] /= at(i, i)[l];
+                }
+            }
+        }
+    }
+};
+
+/// @brief Byte order mark of files written on this machine, as in NumPy type strings.
+static constexpr char native_byte_order = std::endian::native == std::endian::little ? '<' : '>';
+
+/// @brief File element kind of T: bool, signed, unsigned or floating point.
+template <typename T>
+constexpr char element_kind() noexcept
+{
+    static_assert(std::is_arithmetic<T>::value);
+    if constexpr (std::is_same<T, bool>::value) {
+        return 'b';
+    } else if constexpr (std::is_floating_point<T>::value) {
+        return 'f';
+    } else if constexpr (std::is_signed<T>::value) {
+        return 'i';
+    } else {
+        return 'u';
+    }
+}
+
+template <typename M>
+constexpr file_header make_file_header() noexcept
+{
+    using T = typename M::value_type;
+    static_assert(M::dimensions <= 6, "Matrix files store up to 6 dimensions");
+    file_header h{file_magic, element_kind<T>(), sizeof(T), native_byte_order, M::dimensions, 0, {}};
+    std::apply([&h](auto ... s) {
+            int i = 0;
+            ((h.sizes[i++] = s), ...);
+        }, M::sizes);
+    return h;
+}
+
+/// @brief NumPy type string of T.
+template <typename T>
+inline std::string npy_descr()
+{
+    return std::string{sizeof(T) == 1 ? '|' : native_byte_order, element_kind<T>()} + std::to_string(sizeof(T));
+}
+
+/// @brief NumPy .npy version 1.0 header, padded with spaces so the elements start at a multiple of 64 bytes.
+template <typename M>
+inline std::string npy_header()
+{
+    std::string shape;
+    std::apply([&shape](auto ... s) { ((shape += std::to_string(s) + ", "), ...); }, M::sizes);
+    if (M::dimensions > 1) {
+        shape.resize(shape.size() - 2);
+    } else {
+        shape.pop_back();
+    }
+    std::string d = "{'descr': '" + npy_descr<typename M::value_type>() + "', 'fortran_order': False, 'shape': (" +
+                    shape + "), }";
+    d.resize((d.size() + 11 + 63) / 64 * 64 - 11, ' ');
+    d += '\n';
+    const uint16_t n = d.size();
+    return std::string{"\x93NUMPY\x01\x00", 8} + char(n & 0xff) + char(n >> 8) + d;
+}
+
+/// @brief Value of key in a NumPy header dictionary, up to the next comma outside of parentheses.
+inline std::string npy_field(const std::string& h, const std::string& key)
+{
+    auto b = h.find("'" + key + "'");
+    if (b == std::string::npos || (b = h.find(':', b)) == std::string::npos) {
+        return {};
+    }
+    std::string r;
+    int depth = 0;
+    for (++b; b < h.size() && (depth > 0 || (h[b] != ',' && h[b] != '}')); ++b) {
+        depth += h[b] == '(' ? 1 : h[b] == ')' ? -1 : 0;
+        if (h[b] != ' ' && h[b] != '\'') {
+            r += h[b];
+        }
+    }
+    return r;
+}
+
+/// @brief Buffered writer of elements to a file. The buffer is allocated by the first put(), continuous matrices
+/// are written without it.
+template <typename T>
+struct file_writer
+{
+    static constexpr inline std::size_t capacity = std::max<std::size_t>(1, (std::size_t{1} << 20) / sizeof(T));
+
+    std::FILE* file;
+    std::unique_ptr<T[]> buffer;
+    std::size_t count = 0;
+    bool ok = true;
+
+    void put(const T& v) noexcept
+    {
+        if (buffer == nullptr) {
+            buffer.reset(new (std::nothrow) T[capacity]);
+            if (buffer == nullptr) {
+                ok = ok && std::fwrite(&v, sizeof(T), 1, file) == 1;
+                return;
+            }
+        }
+        buffer[count++] = v;
+        if (count == capacity) {
+            flush();
+        }
+    }
+
+    void write(const T* p, std::size_t n) noexcept
+    {
+        flush();
+        ok = ok && std::fwrite(p, sizeof(T), n, file) == n;
+    }
+
+    void flush() noexcept
+    {
+        if (count != 0) {
+            ok = ok && std::fwrite(buffer.get(), sizeof(T), count, file) == count;
+            count = 0;
+        }
+    }
+};
+
+/// @brief Writes the elements in row major order, continuous runs at once and strided ones through the buffer.
+template <typename M, typename W>
+void write_elements(const M& m, W& w) noexcept
+{
+    if constexpr (M::is_continuous) {
+        w.write(m.data(), M::volume);
+    } else if constexpr (M::dimensions == 1) {
+        for (int i = 0; i < std::get<0>(M::sizes); ++i) {
+            w.put(m[i]);
+        }
+    } else {
+        for (int i = 0; i < std::get<0>(M::sizes); ++i) {
+            write_elements(m[i], w);
+        }
+    }
+}
+
+/// @brief Writes the matrix with a matrix file or a NumPy header, false on failure, including running out of memory
+/// for the header.
+template <typename M>
+bool save(const M& m, const char* path, bool npy) noexcept
+{
+    using T = typename M::value_type;
+    std::FILE* f = std::fopen(path, "wb");
+    if (f == nullptr) {
+        return false;
+    }
+    file_writer<T> w{f};
+    if (npy) {
+        try {
+            const auto h = npy_header<M>();
+            w.ok = std::fwrite(h.data(), 1, h.size(), f) == h.size();
+        } catch (const std::bad_alloc&) {
+            w.ok = false;
+        }
+    } else {
+        constexpr file_header h = make_file_header<M>();
+        w.ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+    }
+    write_elements(m, w);
+    w.flush();
+    return std::fclose(f) == 0 && w.ok;
+}
+
+/// @brief Reads a matrix file or a NumPy file into a continuous matrix of type R, null if the file can't be read,
+/// its element type and sizes don't match R or its header can't be allocated.
+template <typename R>
+R load(const char* path, bool npy) noexcept
+{
+    using T = typename R::value_type;
+    std::FILE* f = std::fopen(path, "rb");
+    if (f == nullptr) {
+        return R{nullptr};
+    }
+    bool ok;
+    if (npy) {
+        std::array<char, 12> prefix;
+        ok = std::fread(prefix.data(), 1, 10, f) == 10 && std::memcmp(prefix.data(), "\x93NUMPY", 6) == 0;
+        std::size_t n = 0;
+        if (ok && prefix[6] == 1) {
+            n = uint8_t(prefix[8]) | uint8_t(prefix[9]) << 8;
+        } else if (ok && (prefix[6] == 2 || prefix[6] == 3) && std::fread(prefix.data() + 10, 1, 2, f) == 2) {
+            n = uint32_t(uint8_t(prefix[8])) | uint32_t(uint8_t(prefix[9])) << 8 |
+                uint32_t(uint8_t(prefix[10])) << 16 | uint32_t(uint8_t(prefix[11])) << 24;
+        }
+        try {
+            std::string h(n, ' ');
+            const std::string expected = npy_header<R>();
+            ok = n != 0 && std::fread(h.data(), 1, n, f) == n &&
+                 npy_field(h, "descr") == npy_field(expected, "descr") &&
+                 npy_field(h, "fortran_order") == "False" &&
+                 npy_field(h, "shape") == npy_field(expected, "shape");
+        } catch (const std::bad_alloc&) {
+            ok = false;
+        }
+    } else {
+        constexpr file_header expected = make_file_header<R>();
+        file_header h;
+        ok = std::fread(&h, sizeof(h), 1, f) == 1 && std::memcmp(&h, &expected, sizeof(h)) == 0;
+    }
+    R r{nullptr};
+    if (ok) {
+        r = R{uninitialized};
+        ok = std::fread(r.data(), sizeof(T), R::volume, f) == std::size_t(R::volume);
+    }
+    std::fclose(f);
+    return ok ? std::move(r) : R{nullptr};
+}
+
+#ifdef __unix__
+/// @brief Resource of one mapped file, unmaps it and deletes itself when the mapped elements are released.
+/// Other allocations are forwarded to the default resource.
+class mapped_file_resource final : public std::pmr::memory_resource
+{
+public:
+    mapped_file_resource(void* base, std::size_t length) noexcept
+        : base_{base}
+        , length_{length}
+    {
+    }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        return default_memory_resource()->allocate(bytes, align);
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t align) override
+    {
+        if (p == static_cast<char*>(base_) + sizeof(file_header)) {
+            ::munmap(base_, length_);
+            delete this;
+        } else {
+            default_memory_resource()->deallocate(p, bytes, align);
+        }
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& r) const noexcept override
+    {
+        return this == &r;
+    }
+
+    void* base_;
+    std::size_t length_;
+};
+
+/// @brief Maps the file into a matrix of type M, null if the file can't be mapped or its header doesn't match M.
+template <typename M>
+M map_file(const char* path, map_mode mode, map_advice advice) noexcept
+{
+    using T = typename M::value_type;
+    static_assert(M::is_continuous);
+    constexpr file_header header = make_file_header<M>();
+    constexpr std::size_t length = sizeof(file_header) + M::absolute_volume * sizeof(T);
+    const int flags = mode == map_mode::create ? O_RDWR | O_CREAT | O_TRUNC :
+                      mode == map_mode::shared ? O_RDWR : O_RDONLY;
+    const int fd = ::open(path, flags, 0644);
+    if (fd < 0) {
+        return M{nullptr};
+    }
+    struct stat st;
+    const bool sized = mode == map_mode::create ? ::ftruncate(fd, length) == 0 :
+                                                  ::fstat(fd, &st) == 0 && std::size_t(st.st_size) == length;
+    void* base = MAP_FAILED;
+    if (sized) {
+        base = ::mmap(nullptr,
+                      length,
+                      PROT_READ | PROT_WRITE,
+                      mode == map_mode::read_only || mode == map_mode::copy_on_write ? MAP_PRIVATE : MAP_SHARED,
+                      fd,
+                      0);
+    }
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        return M{nullptr};
+    }
+    if (mode == map_mode::create) {
+        std::memcpy(base, &header, sizeof(file_header));
+    } else if (std::memcmp(base, &header, sizeof(file_header)) != 0) {
+        ::munmap(base, length);
+        return M{nullptr};
+    }
+    constexpr int advices[] = {MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED};
+    ::madvise(base, length, advices[static_cast<int>(advice)]);
+    T* p = reinterpret_cast<T*>(static_cast<char*>(base) + sizeof(file_header));
+    return M{std::span<T, M::absolute_volume>{p, p + M::absolute_volume}, new mapped_file_resource{base, length}};
+}
+#endif
+
+/// @brief Continuous matrix type.
+template <typename T, int ... sizes>
+using continuous_matrixd = typename continuous_matrix_type<T, sizes ...>::type;
+
+/// @brief Matrix type of matrixd: continuous, or a batch of continuous matrices when axis 0 is dynamic.
+template <typename T, int ... sizes>
+struct matrixd_type
+{
+    static_assert(((sizes >= 0) && ...), "Only axis 0 of a matrix may be dynamic");
+    using type = continuous_matrixd<T, sizes ...>;
+};
+
+template <typename T, int ... sizes>
+struct matrixd_type<T, dynamic_extent, sizes ...>
+{
+    static_assert(((sizes >= 0) && ...), "Only axis 0 of a matrix may be dynamic");
+    using type = dynamic_matrix_impl<continuous_matrixd<T, sizes ...>>;
+};
+
+#if defined(__cpp_lib_mdspan)
+/// @brief std::mdspan over the elements of the matrix M: static extents of its sizes and its strides.
+template <typename M, typename T, typename I = std::make_index_sequence<M::dimensions>>
+struct mdspan_type_impl;
+
+template <typename M, typename T, std::size_t ... i>
+struct mdspan_type_impl<M, T, std::index_sequence<i ...>>
+{
+    using extents_type = std::extents<typename M::index_type, static_cast<std::size_t>(std::get<i>(M::sizes)) ...>;
+    using mapping_type = typename std::layout_stride::template mapping<extents_type>;
+    using type = std::mdspan<T, extents_type, std::layout_stride>;
+
+    /// @brief Raw offset of the first element, non-zero for cropped matrices.
+    static constexpr typename M::index_type origin = M::raw_offset(static_cast<int>(i * 0) ...);
+
+    static constexpr std::array<typename M::index_type, M::dimensions> strides{std::get<i>(M::absolute_offsets) ...};
+
+    static constexpr type make(T* data) noexcept
+    {
+        return type{data + origin, mapping_type{extents_type{}, strides}};
+    }
+
+    /// @brief Whether the extents and the strides of the mdspan m are those of M.
+    template <typename N>
+    static constexpr bool matches(const N& m) noexcept
+    {
+        return N::rank() == M::dimensions &&
+               ((m.extent(i) == std::get<i>(M::sizes) && m.stride(i) == std::get<i>(M::absolute_offsets)) && ...);
+    }
+};
+#endif
 
 }
 
@@ -10,8 +10,11 @@ namespace khustup {
 
 namespace impl {
 
+/// @brief Matrix view: a pointer to elements with compile time sizes and strides. Trivially copy constructible and
+/// destructible and never owns the elements, so it is passed in registers and cheap to return from element access
+/// in hot loops.
 template <typename T, int abs_size, int abs_offset, int offset, int size, int ... tail>
-struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
+struct matrix_view<T, abs_size, abs_offset, offset, size, tail ...>
 {
     /// @name Properties
     /// @{
@@ -20,14 +23,18 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
                                                  offset >= 0 &&
                                                  size >= 0 &&
                                                  offset + size <= abs_size &&
-                                                 matrix_impl<T, tail ...>::is_consistent;
+                                                 matrix_view<T, tail ...>::is_consistent;
     static_assert(is_consistent);
 
     static constexpr inline int dimensions = sizeof...(tail) / 4 + 1;
 
-    static constexpr inline int64_t volume = size * matrix_impl<T, tail ...>::volume;
+    static constexpr inline int64_t volume = size * matrix_view<T, tail ...>::volume;
 
-    static constexpr inline int64_t absolute_volume = abs_size * matrix_impl<T, tail ...>::absolute_volume;
+    static constexpr inline int64_t absolute_volume = abs_size * matrix_view<T, tail ...>::absolute_volume;
+
+    /// @brief Elements spanned by the strides of the axes, raw offsets are below it.
+    static constexpr inline int64_t absolute_extent = std::max(int64_t{abs_size} * abs_offset,
+                                                               matrix_view<T, tail ...>::absolute_extent);
 
     static constexpr inline auto sizes = extracted_sizes<abs_size, abs_offset, offset, size, tail ...>;
 
@@ -49,281 +56,293 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
 
     static constexpr inline bool is_cropped = offset != 0 ||
                                               size != abs_size ||
-                                              matrix_impl<T, tail ...>::is_cropped;
+                                              matrix_view<T, tail ...>::is_cropped;
 
     static constexpr inline bool axes_swapped = abs_offset != impl::volume<tail ...> ||
-                                                matrix_impl<T, tail ...>::axes_swapped;
+                                                matrix_view<T, tail ...>::axes_swapped;
 
     static constexpr inline bool is_continuous = ((!is_cropped) && (!axes_swapped));
+
+    /// @brief Whether owned matrices keep their elements inline instead of allocating them.
+    static constexpr inline bool is_inline = absolute_volume * sizeof(T) <= inline_bytes;
     /// @}
 
     /// @name Utilities
     /// @{
+    /// @brief Type of the elements, without the const of views of const elements.
+    using value_type = std::remove_const_t<T>;
+
+    /// @brief Matrix type with the same sizes and strides, which may own its elements.
+    using matrix_type = matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>;
+
+    using view_type = matrix_view;
+
+    /// @brief View of the same elements that can't write to them, returned by const access to owned matrices.
+    using const_view_type = matrix_view<const T, abs_size, abs_offset, offset, size, tail ...>;
+
+    /// @brief Iterators over the elements in row major order: pointers for continuous matrices, strided iterators
+    /// otherwise.
+    using iterator = std::conditional_t<is_continuous, T*, impl::strided_iterator<matrix_view, T>>;
+
+    using const_iterator = std::conditional_t<is_continuous, const T*, impl::strided_iterator<matrix_view, const T>>;
+
+    /// @brief Type of raw offsets: int, std::ptrdiff_t only when they don't fit into it.
+    using index_type = impl::offset_type<absolute_extent>;
+
     template <typename H, typename ... I>
-    static constexpr inline int raw_offset(H h, I ... i) noexcept
+    static constexpr inline index_type raw_offset(H h, I ... i) noexcept
     {
         static_assert(std::is_same<int, H>::value);
-        return (h + offset) * abs_offset + matrix_impl<T, tail ...>::raw_offset(i ...);
+        return index_type{h + offset} * abs_offset + matrix_view<T, tail ...>::raw_offset(i ...);
     }
 
-    static constexpr inline int raw_offset(int h) noexcept
+    static constexpr inline index_type raw_offset(int h) noexcept
     {
-        return (h + offset) * abs_offset;
+        return index_type{h + offset} * abs_offset;
     }
 
     template <int i, int j>
-    using swap_axes_matrix_type = typename matrix_swap_axes_type<i, j, matrix_impl>::type;
+    using swap_axes_matrix_type = typename matrix_view_type<typename matrix_swap_axes_type<i, j, matrix_type>::type>::type;
 
     template <int index_count>
-    using submatrix_type = typename impl::submatrix_type<matrix_impl, index_count>::type;
+    using submatrix_type = typename matrix_view_type<typename impl::submatrix_type<matrix_type, index_count>::type>::type;
 
     template <int new_offset, int new_size, int ... new_tail>
-    using cropped_matrix_type = typename impl::cropped_matrix_type<matrix_impl<T, tail ...>,
-                                                                   matrix_impl<T,
-                                                                               abs_size,
-                                                                               abs_offset,
-                                                                               offset + new_offset,
-                                                                               new_size
-                                                                              >,
-                                                                   new_tail ...>::type;
+    using cropped_matrix_type = typename matrix_view_type<typename impl::cropped_matrix_type<matrix_type,
+                                                                                             new_offset,
+                                                                                             new_size,
+                                                                                             new_tail ...>::type
+                                                         >::type;
+
+    template <int ... slices>
+    using sliced_matrix_type = typename matrix_view_type<typename impl::sliced_matrix_type<matrix_type, slices ...>::type
+                                                        >::type;
 
     template <typename M>
-    using dot_product_type = typename dot_product_matrix_type_impl<matrix_impl,
-                                                                   M,
-                                                                   std::integer_sequence<int>>::type;
+    using dot_product_type = typename dot_product_matrix_type_impl<matrix_type,
+                                                                   typename M::matrix_type>::type;
 
     template <typename M>
-    using max_size_matrix_type = typename max_size_matrix_type_impl<matrix_impl, M, std::integer_sequence<int>>::type;
+    using max_size_matrix_type = typename max_size_matrix_type_impl<matrix_type, typename M::matrix_type>::type;
+
+    using continuous_matrix_type = impl::continuous_matrix_type_from_matrix<matrix_type>;
+
+    template <typename U>
+    using cast_matrix_type = impl::continuous_matrix_type_from_matrix<typename matrix_rebind_type<U, matrix_type>::type>;
+
+    template <typename F>
+    using map_matrix_type = cast_matrix_type<std::remove_cvref_t<std::invoke_result_t<const F&, const T&>>>;
+
+    template <typename M, typename F>
+    using zip_matrix_type = typename matrix_rebind_type<
+        std::remove_cvref_t<std::invoke_result_t<const F&, const T&, const typename M::value_type&>>,
+        max_size_matrix_type<M>>::type;
 
-    using continuous_matrix_type = impl::continuous_matrix_type_from_matrix<matrix_impl>;
+    using mask_type = cast_matrix_type<bool>;
+
+    template <int axis, int new_size, typename U = value_type>
+    using resized_matrix_type = typename impl::resized_matrix_type<U, axis, new_size, matrix_view>::type;
     /// @}
 
     /// @name Construction & Destruction
     /// @{
-    constexpr matrix_impl(std::span<T, absolute_volume> d) noexcept
+    constexpr matrix_view(std::span<T, absolute_volume> d) noexcept
         : data_{d.data()}
-        , allocated_{false}
     {
         assert(is_consistent_check());
     }
 
-    constexpr matrix_impl(const matrix_impl& m) noexcept
-        : data_{m.data_}
-        , allocated_{false}
+    constexpr matrix_view(T* s, T* e) noexcept
+        : matrix_view(std::span<T, absolute_volume>{s, e})
     {
-        if (m.allocated_) {
-            assert(is_continuous);
-            data_ = new T[absolute_volume]{};
-            std::copy(m.data_, m.data_ + absolute_volume, data_);
-            allocated_ = true;
-        }
+        assert(std::distance(s, e) == absolute_volume);
         assert(is_consistent_check());
     }
 
-    template <typename M>
-    constexpr matrix_impl(const M& m) noexcept
-        : matrix_impl{}
+    constexpr explicit matrix_view(std::nullptr_t) noexcept
+        : data_{nullptr}
     {
-        static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
-        static_assert(is_continuous);
-        if (std::get<0>(M::sizes) == 1) {
-            for (auto i = 0; i < size; ++i) {
-                operator[](i) = m[0];
-            }
-        } else {
-            for (auto i = 0; i < size; ++i) {
-                operator[](i) = m[i];
-            }
-        }
-        assert(is_consistent_check());
     }
 
-    constexpr matrix_impl(matrix_impl&& m) noexcept
+    /// @brief View of const elements over the elements of a view.
+    template <typename U>
+        requires std::is_same<const U, T>::value && (!std::is_same<U, T>::value)
+    constexpr matrix_view(const matrix_view<U, abs_size, abs_offset, offset, size, tail ...>& m) noexcept
         : data_{m.data_}
-        , allocated_{m.allocated_}
     {
-        m.allocated_ = false;
-        assert(is_consistent_check());
-        assert(m.is_consistent_check());
     }
 
-    constexpr explicit matrix_impl(std::nullptr_t) noexcept
-        : data_{nullptr}
-        , allocated_{false}
+    /// @brief View of the elements of an owned matrix, which copies them first when they are shared as the view may
+    /// write to them.
+    constexpr matrix_view(matrix_impl<value_type, abs_size, abs_offset, offset, size, tail ...>& m) noexcept
+        requires (!std::is_const<T>::value)
+        : data_{m.data()}
     {
-        static_assert(is_continuous);
-        assert(is_consistent_check());
     }
 
-    constexpr explicit matrix_impl() noexcept
-        : data_{new T[absolute_volume]{}}
-        , allocated_{true}
+    /// @brief View of const elements over the elements of an owned matrix, even a shared one.
+    constexpr matrix_view(const matrix_impl<value_type, abs_size, abs_offset, offset, size, tail ...>& m) noexcept
+        requires std::is_const<T>::value
+        : data_{m.data()}
     {
-        static_assert(is_continuous);
-        assert(is_consistent_check());
     }
 
-    constexpr explicit matrix_impl(const T& v) noexcept
-        : matrix_impl{}
-    {
-        std::fill(data_, data_ + absolute_volume, v);
-        assert(is_consistent_check());
-    }
+    constexpr matrix_view(const matrix_view& m) noexcept = default;
 
-    constexpr matrix_impl(T* s, T* e) noexcept
-        : matrix_impl(std::span<T, absolute_volume>{s, e})
+    constexpr matrix_view(matrix_view&& m) noexcept = default;
+
+    /// @brief Assignment writes the elements, as for owned matrices. rebind() points the view to other elements
+    /// instead, like assigning a std::span.
+    constexpr matrix_view& operator=(const matrix_view& m) & noexcept
     {
-        assert(std::distance(s, e) == absolute_volume);
-        assert(is_consistent_check());
+        assign(m);
+        return *this;
     }
 
-    ~matrix_impl() noexcept
+    template <typename M>
+    constexpr matrix_view& operator=(const M& m) & noexcept
     {
-        if (allocated_) {
-            delete[] data_;
-        }
+        assign(m);
+        return *this;
     }
 
-    constexpr matrix_impl& operator=(const matrix_impl& m) noexcept
+    template <typename M>
+    constexpr matrix_view& operator=(const M& m) && noexcept
     {
-        if (this != (&m)) {
-            for (auto i = 0; i < size; ++i) {
-                operator[](i) = m[i];
-            }
-        }
-        assert(is_consistent_check());
+        assign(m);
         return *this;
     }
 
-    constexpr matrix_impl& operator=(matrix_impl&& m) noexcept
+    constexpr void rebind(const matrix_view& m) noexcept
     {
-        if (allocated_) {
-            delete[] data_;
-        }
         data_ = m.data_;
-        allocated_ = m.allocated_;
-        m.allocated_ = false;
-        assert(is_consistent_check());
-        assert(m.is_consistent_check());
-        return *this;
     }
 
-    template <typename M>
-    constexpr matrix_impl& operator=(const M& m) noexcept
+    /// @brief Writes the matrix to a file: a 64 byte header with the element type, byte order and sizes followed by
+    /// the elements in row major order. False on failure.
+    bool save(const char* path) const noexcept
     {
-        static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
-        if (std::get<0>(M::sizes) == 1) {
-            for (auto i = 0; i < size; ++i) {
-                operator[](i) = m[0];
-            }
-        } else {
-            for (auto i = 0; i < size; ++i) {
-                operator[](i) = m[i];
-            }
-        }
-        assert(is_consistent_check());
-        return *this;
+        return impl::save(*this, path, false);
     }
 
-    constexpr matrix_impl& operator=(const T& v) noexcept
+    /// @brief Writes the matrix to a NumPy .npy file. False on failure.
+    bool save_npy(const char* path) const noexcept
     {
-        for (auto i = 0; i < size; ++i) {
-            operator[](i) = v;
-        }
-        assert(is_consistent_check());
-        return *this;
+        return impl::save(*this, path, true);
+    }
+
+    /// @brief Reads a matrix written by save, null if the element type or the sizes don't match.
+    static continuous_matrix_type load(const char* path) noexcept
+    {
+        return impl::load<continuous_matrix_type>(path, false);
+    }
+
+    /// @brief Reads a C order NumPy .npy file, null if the element type or the shape don't match.
+    static continuous_matrix_type load_npy(const char* path) noexcept
+    {
+        return impl::load<continuous_matrix_type>(path, true);
     }
 
     constexpr continuous_matrix_type copy() const noexcept
     {
-        if (allocated_) {
-            return continuous_matrix_type{*this};
-        }
-        continuous_matrix_type r;
+        continuous_matrix_type r{uninitialized};
         r = *this;
         return r;
     }
+
+    template <typename U, bool saturate = false>
+    constexpr cast_matrix_type<U> cast() const noexcept
+    {
+        cast_matrix_type<U> r{uninitialized};
+        cast_into<saturate>(r);
+        return r;
+    }
+
+    template <bool saturate = false, typename M>
+    constexpr void cast_into(M&& m) const noexcept
+    {
+        using R = std::remove_cvref_t<M>;
+        static_assert(sizes == R::sizes);
+        m.detach();
+        cast_calculator<matrix_view, typename R::view_type, saturate>::calculate(*this, m);
+        assert(is_consistent_check());
+    }
     /// @}
 
     /// @name Swap axes, Crop, Reshape
     /// @{
     template <int i, int j>
-    constexpr swap_axes_matrix_type<i, j> swap_axes() const& noexcept
+    constexpr swap_axes_matrix_type<i, j> swap_axes() const noexcept
     {
         return swap_axes_matrix_type<i, j>{data_, data_ + absolute_volume};
     }
 
-    template <int i, int j>
-    constexpr swap_axes_matrix_type<i, j> swap_axes() && noexcept
-    {
-        auto r = swap_axes_matrix_type<i, j>{data_, data_ + absolute_volume};
-        r.allocated_ = allocated_;
-        allocated_ = false;
-        return r;
-    }
-
     template <int new_offset, int new_size, int ... new_tail>
-    constexpr cropped_matrix_type<new_offset, new_size, new_tail ...> crop() const& noexcept
+    constexpr cropped_matrix_type<new_offset, new_size, new_tail ...> crop() const noexcept
     {
         static_assert(sizeof...(new_tail) == sizeof...(tail) / 2);
         return cropped_matrix_type<new_offset, new_size, new_tail ...>{data_, data_ + absolute_volume};
     }
 
-    template <int new_offset, int new_size, int ... new_tail>
-    constexpr cropped_matrix_type<new_offset, new_size, new_tail ...> crop() && noexcept
+    /// @brief View of every step-th element of each axis, given (offset, size, step) per axis. Unlike crop() it
+    /// only changes the strides, so kernels run on the view without copying.
+    template <int ... slices>
+    constexpr sliced_matrix_type<slices ...> slice() const noexcept
     {
-        static_assert(sizeof...(new_tail) == sizeof...(tail) / 2);
-        auto r = cropped_matrix_type<new_offset, new_size, new_tail ...>{data_, data_ + absolute_volume};
-        r.allocated_ = allocated_;
-        allocated_ = false;
-        return r;
+        static_assert(sizeof...(slices) == dimensions * 3);
+        using R = sliced_matrix_type<slices ...>;
+        constexpr auto shift = impl::sliced_matrix_type<matrix_type, slices ...>::shift;
+        return R{data_ + shift, data_ + shift + R::absolute_volume};
     }
 
+    /// @brief Same elements in the same order with new sizes, without copying them. Other than continuous matrices,
+    /// only views whose merged or split axes are strided as in a continuous matrix can be reshaped.
     template <int ... sizes>
-    constexpr continuous_matrixd<T, sizes ...> reshape() const& noexcept
+    constexpr auto reshape() const noexcept
     {
-        static_assert(continuous_matrixd<T, sizes ...>::volume == volume);
-        static_assert(!is_cropped, "Can't reshape cropped matrix");
-        return continuous_matrixd<T, sizes ...>{data_, data_ + volume};
+        static_assert(continuous_matrixd<value_type, sizes ...>::volume == volume);
+        if constexpr (is_continuous) {
+            using V = typename matrix_view_type<continuous_matrixd<T, sizes ...>>::type;
+            return V{data_, data_ + volume};
+        } else {
+            using R = impl::reshaped_matrix_type<matrix_type, sizes ...>;
+            static_assert(R::is_view, "Can't reshape the matrix without a copy, use reshape_copy()");
+            using V = typename matrix_view_type<typename R::type>::type;
+            return V{data_ + R::shift, data_ + R::shift + V::absolute_volume};
+        }
     }
 
     template <int ... sizes>
-    constexpr continuous_matrixd<T, sizes ...> reshape() && noexcept
+    constexpr continuous_matrixd<value_type, sizes ...> reshape_copy() const noexcept
     {
-        static_assert(continuous_matrixd<T, sizes ...>::volume == volume);
-        static_assert(!is_cropped, "Can't reshape cropped matrix");
-        auto r = continuous_matrixd<T, sizes ...>{data_, data_ + volume};
-        r.allocated_ = allocated_;
-        allocated_ = false;
-        return r;
+        return copy().template reshape<sizes ...>();
     }
+
     /// @}
 
     /// @name Element Access
     /// @{
-    constexpr matrix_impl<T, tail...> operator[](int index) noexcept
+    constexpr matrix_view<T, tail...> operator[](int index) noexcept
     {
         assert(index < size && index >= 0);
-        constexpr int vv = matrix_impl<T, tail...>::absolute_volume;
+        constexpr auto vv = matrix_view<T, tail...>::absolute_volume;
         assert(is_consistent_check());
-        return matrix_impl<T, tail...>{data_ + abs_offset * (index + offset),
-                                                        data_ + abs_offset * (index + offset) + vv};
+        return matrix_view<T, tail...>{data_ + raw_offset(index), data_ + raw_offset(index) + vv};
     }
 
-    constexpr const matrix_impl<T, tail...> operator[](int index) const noexcept
+    constexpr const matrix_view<T, tail...> operator[](int index) const noexcept
     {
         assert(index < size && index >= 0);
-        constexpr int vv = matrix_impl<T, tail...>::absolute_volume;
+        constexpr auto vv = matrix_view<T, tail...>::absolute_volume;
         assert(is_consistent_check());
-        return matrix_impl<T, tail...>{data_ + abs_offset * (index + offset),
-                                                        data_ + abs_offset * (index + offset) + vv};
+        return matrix_view<T, tail...>{data_ + raw_offset(index), data_ + raw_offset(index) + vv};
     }
 
     template <typename ... I>
     constexpr T& at(I ... indices) noexcept
     {
         static_assert(sizeof...(indices) == sizeof...(tail) / 4 + 1);
-        assert(raw_offset(indices ...) < absolute_volume);
+        assert(raw_offset(indices ...) < absolute_extent);
         assert(is_consistent_check());
         return data_[raw_offset(indices ...)];
     }
@@ -332,7 +351,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
     constexpr const T& at(I ... indices) const noexcept
     {
         static_assert(sizeof...(indices) == sizeof...(tail) / 4 + 1);
-        assert(raw_offset(indices ...) < absolute_volume);
+        assert(raw_offset(indices ...) < absolute_extent);
         assert(is_consistent_check());
         return data_[raw_offset(indices ...)];
     }
@@ -342,7 +361,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
     {
         static_assert(sizeof...(indices) < sizeof...(tail) / 4 + 1);
         const auto o = raw_offset(indices ...);
-        assert(o < absolute_volume);
+        assert(o < absolute_extent);
         constexpr auto v = submatrix_type<sizeof...(indices)>::absolute_volume;
         assert(is_consistent_check());
         return submatrix_type<sizeof...(indices)>{data_ + o, data_ + o + v};
@@ -353,7 +372,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
     {
         static_assert(sizeof...(indices) < sizeof...(tail) / 4 + 1);
         const auto o = raw_offset(indices ...);
-        assert(o < absolute_volume);
+        assert(o < absolute_extent);
         constexpr auto v = submatrix_type<sizeof...(indices)>::absolute_volume;
         assert(is_consistent_check());
         return submatrix_type<sizeof...(indices)>{data_ + o, data_ + o + v};
@@ -363,7 +382,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
     /// @name Operations
     /// @{
     template <typename M>
-    constexpr matrix_impl& operator+=(const M& m) noexcept
+    constexpr matrix_view& operator+=(const M& m) noexcept
     {
         static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
         if (std::get<0>(M::sizes) == 1) {
@@ -379,7 +398,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
         return *this;
     }
 
-    constexpr matrix_impl& operator+=(const T& v) noexcept
+    constexpr matrix_view& operator+=(const T& v) noexcept
     {
         for (auto i = 0; i < size; ++i) {
             operator[](i) += v;
@@ -389,7 +408,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
     }
 
     template <typename M>
-    constexpr matrix_impl& operator-=(const M& m) noexcept
+    constexpr matrix_view& operator-=(const M& m) noexcept
     {
         static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
         if (std::get<0>(M::sizes) == 1) {
@@ -405,7 +424,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
         return *this;
     }
 
-    constexpr matrix_impl& operator-=(const T& v) noexcept
+    constexpr matrix_view& operator-=(const T& v) noexcept
     {
         for (auto i = 0; i < size; ++i) {
             operator[](i) -= v;
@@ -415,7 +434,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
     }
 
     template <typename M>
-    constexpr matrix_impl& operator*=(const M& m) noexcept
+    constexpr matrix_view& operator*=(const M& m) noexcept
     {
         static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
         if (std::get<0>(M::sizes) == 1) {
@@ -431,7 +450,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
         return *this;
     }
 
-    constexpr matrix_impl& operator*=(const T& v) noexcept
+    constexpr matrix_view& operator*=(const T& v) noexcept
     {
         for (auto i = 0; i < size; ++i) {
             operator[](i) *= v;
@@ -441,7 +460,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
     }
 
     template <typename M>
-    constexpr matrix_impl& operator/=(const M& m) noexcept
+    constexpr matrix_view& operator/=(const M& m) noexcept
     {
         static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
         if (std::get<0>(M::sizes) == 1) {
@@ -457,7 +476,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
         return *this;
     }
 
-    constexpr matrix_impl& operator/=(const T& v) noexcept
+    constexpr matrix_view& operator/=(const T& v) noexcept
     {
         for (auto i = 0; i < size; ++i) {
             operator[](i) /= v;
@@ -466,12 +485,12 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
         return *this;
     }
 
-    template <int ... sizes_and_offsets>
-    constexpr auto operator+(const matrix_impl<T, sizes_and_offsets ...>& m) const noexcept -> max_size_matrix_type<matrix_impl<T, sizes_and_offsets ...>>
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto operator+(const M& m) const noexcept -> max_size_matrix_type<M>
     {
-        using M = matrix_impl<T, sizes_and_offsets ...>;
         static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
-        max_size_matrix_type<M> mm = copy();
+        auto mm = promoted_copy<max_size_matrix_type<M>>(*this);
         mm += m;
         return mm;
     }
@@ -483,12 +502,12 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
         return mm;
     }
 
-    template <int ... sizes_and_offsets>
-    constexpr auto operator-(const matrix_impl<T, sizes_and_offsets ...>& m) const noexcept -> max_size_matrix_type<matrix_impl<T, sizes_and_offsets ...>>
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto operator-(const M& m) const noexcept -> max_size_matrix_type<M>
     {
-        using M = matrix_impl<T, sizes_and_offsets ...>;
         static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
-        max_size_matrix_type<M> mm = copy();
+        auto mm = promoted_copy<max_size_matrix_type<M>>(*this);
         mm -= m;
         return mm;
     }
@@ -500,12 +519,12 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
         return mm;
     }
 
-    template <int ... sizes_and_offsets>
-    constexpr auto operator*(const matrix_impl<T, sizes_and_offsets ...>& m) const noexcept -> max_size_matrix_type<matrix_impl<T, sizes_and_offsets ...>>
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto operator*(const M& m) const noexcept -> max_size_matrix_type<M>
     {
-        using M = matrix_impl<T, sizes_and_offsets ...>;
         static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
-        max_size_matrix_type<M> mm = copy();
+        auto mm = promoted_copy<max_size_matrix_type<M>>(*this);
         mm *= m;
         return mm;
     }
@@ -517,12 +536,12 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
         return mm;
     }
 
-    template <int ... sizes_and_offsets>
-    constexpr auto operator/(const matrix_impl<T, sizes_and_offsets ...>& m) const noexcept -> max_size_matrix_type<matrix_impl<T, sizes_and_offsets ...>>
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto operator/(const M& m) const noexcept -> max_size_matrix_type<M>
     {
-        using M = matrix_impl<T, sizes_and_offsets ...>;
         static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
-        max_size_matrix_type<M> mm = copy();
+        auto mm = promoted_copy<max_size_matrix_type<M>>(*this);
         mm /= m;
         return mm;
     }
@@ -537,27 +556,144 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
     template <typename M>
     constexpr auto dot(const M& m) const noexcept -> dot_product_type<M>
     {
-        dot_product_type<M> r;
-        constexpr int s0 = std::tuple_size<decltype(sizes)>::value;
-        constexpr bool s = s0 == 2;
-        constexpr bool s1 = std::get<0>(sizes) == 1;
-        constexpr bool s2 = std::get<0>(M::sizes) == 1;
-        constexpr bool c = (dot_product_type<M>::volume * std::get<s0 - 1>(sizes)) > crit_compl;
-        dot_product_calculator<matrix_impl, M, s, s1, s2, c>::calculate(*this, m, r);
+        dot_product_type<M> r{uninitialized};
+        constexpr bool c = (dot_product_type<M>::volume * std::get<dimensions - 1>(sizes)) > crit_compl;
+        dot_into<c>(*this, m, r);
         return r;
     }
 
     constexpr continuous_matrix_type sqrt() const noexcept
     {
         auto mm = copy();
-        impl::sqrt_calculator<continuous_matrix_type>::calculate(mm);
+        mm.map_inplace([](const T& v) { return static_cast<T>(std::sqrt(v)); });
         return mm;
     }
+
+    /// Big matrices are processed in parallel, so f must be safe to call concurrently.
+    template <typename F>
+    constexpr map_matrix_type<F> map(const F& f) const noexcept
+    {
+        map_matrix_type<F> r{uninitialized};
+        element_wise([&f](auto& o, const T& v) { o = f(v); }, r, *this);
+        return r;
+    }
+
+    template <typename F>
+    constexpr matrix_view& map_inplace(const F& f) noexcept
+    {
+        element_wise([&f](T& v) { v = f(v); }, *this);
+        assert(is_consistent_check());
+        return *this;
+    }
+
+    template <typename M, typename F>
+    constexpr zip_matrix_type<M, F> zip_with(const M& m, const F& f) const noexcept
+    {
+        zip_matrix_type<M, F> r{uninitialized};
+        element_wise([&f](auto& o, const T& a, const auto& b) { o = f(a, b); }, r, *this, m);
+        return r;
+    }
+
+    template <typename M, typename F>
+    constexpr matrix_view& zip_with_inplace(const M& m, const F& f) noexcept
+    {
+        static_assert(max_size_matrix_type<M>::sizes == sizes);
+        element_wise([&f](T& a, const auto& b) { a = f(a, b); }, *this, m);
+        assert(is_consistent_check());
+        return *this;
+    }
+
+    /// Calls f(element, indices ...) for every element.
+    template <typename F>
+    constexpr void for_each_indexed(const F& f) noexcept
+    {
+        indexed_calculator<matrix_view, (volume > crit_compl)>::calculate(f, *this);
+    }
+
+    template <typename F>
+    constexpr void for_each_indexed(const F& f) const noexcept
+    {
+        indexed_calculator<matrix_view, (volume > crit_compl)>::calculate(f, *this);
+    }
+
+    template <int axis, typename Op = std::plus<>, bool inclusive = true>
+    constexpr continuous_matrix_type scan(const Op& op = Op{}) const noexcept
+    {
+        auto r = copy();
+        scan_along<axis, inclusive>(r, op);
+        return r;
+    }
+
+    template <int axis>
+    constexpr continuous_matrix_type cumsum() const noexcept
+    {
+        return scan<axis, std::plus<>>();
+    }
+
+    template <int axis>
+    constexpr continuous_matrix_type cumprod() const noexcept
+    {
+        return scan<axis, std::multiplies<>>();
+    }
+
+    template <int axis, int k, typename Compare = std::greater<>>
+    constexpr auto topk(const Compare& comp = Compare{}) const noexcept
+        -> std::pair<resized_matrix_type<axis, k>, resized_matrix_type<axis, k, int>>
+    {
+        return topk_along<axis, k>(*this, comp);
+    }
+
+    template <int axis>
+    constexpr resized_matrix_type<axis, 1, int> argmax() const noexcept
+    {
+        return topk<axis, 1>().second;
+    }
+
+    template <int axis>
+    constexpr resized_matrix_type<axis, 1, int> argmin() const noexcept
+    {
+        return topk<axis, 1, std::less<>>().second;
+    }
+
+    template <typename D>
+    constexpr matrix_view& fill_random(uint64_t seed, const D& distribution = D{}) noexcept
+    {
+        random_fill(*this, seed, distribution);
+        assert(is_consistent_check());
+        return *this;
+    }
+
+    constexpr continuous_matrix_type clamp(const T& lo, const T& hi) const noexcept
+    {
+        return map([lo, hi](const T& v) { return v < lo ? lo : (hi < v ? hi : v); });
+    }
+
+    template <typename M>
+    constexpr auto min(const M& m) const noexcept
+    {
+        return zip_with(m, [](const T& a, const auto& b) { return b < a ? b : a; });
+    }
+
+    constexpr continuous_matrix_type min(const T& v) const noexcept
+    {
+        return map([v](const T& a) { return v < a ? v : a; });
+    }
+
+    template <typename M>
+    constexpr auto max(const M& m) const noexcept
+    {
+        return zip_with(m, [](const T& a, const auto& b) { return a < b ? b : a; });
+    }
+
+    constexpr continuous_matrix_type max(const T& v) const noexcept
+    {
+        return map([v](const T& a) { return a < v ? v : a; });
+    }
     /// @}
 
     /// @name Comparison
     /// @{
-    constexpr bool operator==(const matrix_impl& m) const noexcept
+    constexpr bool operator==(const matrix_view& m) const noexcept
     {
         if (data_ == m.data_) {
             return true;
@@ -592,267 +728,449 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size, tail ...>
     {
         return !((*this) == m);
     }
-    /// @}
 
-    /// @name Access to data.
-    /// @{
-    T* data() noexcept
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto operator<(const M& m) const noexcept
     {
-        return data_;
+        return zip_with(m, [](const T& a, const auto& b) -> bool { return a < b; });
     }
 
-    const T* data() const noexcept
+    constexpr mask_type operator<(const T& v) const noexcept
     {
-        return data_;
+        return map([v](const T& a) -> bool { return a < v; });
     }
-    /// @}
-
-    template <typename T1, int ... values>
-    friend class matrix_impl;
 
-private:
-    bool is_consistent_check() const noexcept
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto operator<=(const M& m) const noexcept
     {
-        return true;
+        return zip_with(m, [](const T& a, const auto& b) -> bool { return a <= b; });
     }
 
-private:
-    T* data_;
-    bool allocated_;
-};
-
-template <typename T, int abs_size, int abs_offset, int offset, int size>
-struct matrix_impl<T, abs_size, abs_offset, offset, size>
-{
-    /// @name Properties
-    /// @{
-    static constexpr inline bool is_consistent = abs_size >= 0 &&
-                                                 abs_offset >= 0 &&
-                                                 offset >= 0 &&
-                                                 size >= 0 &&
-                                                 offset + size <= abs_size;
-    static_assert(is_consistent);
-
-    static constexpr inline int dimensions = 1;
-
-    static constexpr inline int64_t volume = size;
+    constexpr mask_type operator<=(const T& v) const noexcept
+    {
+        return map([v](const T& a) -> bool { return a <= v; });
+    }
 
-    static constexpr inline int64_t absolute_volume = abs_size;
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto operator>(const M& m) const noexcept
+    {
+        return zip_with(m, [](const T& a, const auto& b) -> bool { return a > b; });
+    }
 
-    static constexpr inline auto sizes = std::make_tuple(size);
+    constexpr mask_type operator>(const T& v) const noexcept
+    {
+        return map([v](const T& a) -> bool { return a > v; });
+    }
 
-    static constexpr inline auto offsets = std::make_tuple(offset);
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto operator>=(const M& m) const noexcept
+    {
+        return zip_with(m, [](const T& a, const auto& b) -> bool { return a >= b; });
+    }
 
-    static constexpr inline auto absolute_sizes = std::make_tuple(abs_size);
+    constexpr mask_type operator>=(const T& v) const noexcept
+    {
+        return map([v](const T& a) -> bool { return a >= v; });
+    }
 
-    static constexpr inline auto absolute_offsets = std::make_tuple(abs_offset);
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto equal(const M& m) const noexcept
+    {
+        return zip_with(m, [](const T& a, const auto& b) -> bool { return a == b; });
+    }
 
-    static constexpr inline bool is_cropped = (offset != 0 || size != abs_size);
+    constexpr mask_type equal(const T& v) const noexcept
+    {
+        return map([v](const T& a) -> bool { return a == v; });
+    }
 
-    static constexpr inline bool axes_swapped = (abs_offset != 1);
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto not_equal(const M& m) const noexcept
+    {
+        return zip_with(m, [](const T& a, const auto& b) -> bool { return a != b; });
+    }
 
-    static constexpr inline bool is_continuous = ((!is_cropped) && (!axes_swapped));
+    constexpr mask_type not_equal(const T& v) const noexcept
+    {
+        return map([v](const T& a) -> bool { return a != v; });
+    }
     /// @}
 
-    /// @name Utilities
+    /// @name Iterators
+    /// Standard algorithms, including the parallel ones, apply to the elements in row major order.
     /// @{
-    static constexpr inline int raw_offset(int h) noexcept
+    constexpr iterator begin() noexcept
     {
-        return (h + offset) * abs_offset;
+        if constexpr (is_continuous) {
+            return data_;
+        } else {
+            return iterator{data_, 0};
+        }
     }
 
-    template <int new_offset, int new_size>
-    using cropped_matrix_type = matrix_impl<T, abs_size, abs_offset, offset + new_offset, new_size>;
-
-    using continuous_matrix_type = impl::continuous_matrix_type_from_matrix<matrix_impl>;
+    constexpr iterator end() noexcept
+    {
+        if constexpr (is_continuous) {
+            return data_ + volume;
+        } else {
+            return iterator{data_, volume};
+        }
+    }
 
-    template <typename M>
-    using max_size_matrix_type = typename max_size_matrix_type_impl<matrix_impl, M, std::integer_sequence<int>>::type;
+    constexpr const_iterator begin() const noexcept
+    {
+        if constexpr (is_continuous) {
+            return data_;
+        } else {
+            return const_iterator{data_, 0};
+        }
+    }
+
+    constexpr const_iterator end() const noexcept
+    {
+        if constexpr (is_continuous) {
+            return data_ + volume;
+        } else {
+            return const_iterator{data_, volume};
+        }
+    }
+
+    /// @brief Range of the submatrices along the axis, swap_axes<0, axis>()[i] for every index i of the axis.
+    template <int axis = 0>
+    constexpr auto axis_range() const noexcept
+    {
+        return std::views::iota(0, std::get<axis>(sizes)) |
+               std::views::transform([v = swap_axes<0, axis>()](int i) { return v[i]; });
+    }
     /// @}
 
-    /// @name Construction & Destruction
+    /// @name Access to data.
     /// @{
-    constexpr matrix_impl(std::span<T, absolute_volume> d) noexcept
-        : data_{d.data()}
-        , allocated_{false}
+    T* data() noexcept
     {
-        assert(is_consistent_check());
+        return data_;
     }
 
-    constexpr matrix_impl(const matrix_impl& m) noexcept
-        : data_{m.data_}
-        , allocated_{false}
+    const T* data() const noexcept
     {
-        if (m.allocated_) {
-            assert(is_continuous);
-            data_ = new T[absolute_volume]{};
-            std::copy(m.data_, m.data_ + absolute_volume, data_);
-            allocated_ = true;
-        }
-        assert(is_consistent_check());
+        return data_;
+    }
+
+#if defined(__cpp_lib_mdspan)
+    /// @brief std::mdspan over the elements with static extents and layout_stride, without copying.
+    constexpr auto to_mdspan() noexcept
+    {
+        return impl::mdspan_type_impl<matrix_view, T>::make(data_);
     }
 
+    constexpr auto to_mdspan() const noexcept
+    {
+        return impl::mdspan_type_impl<matrix_view, const T>::make(data_);
+    }
+#endif
+    /// @}
 
-    template <typename M>
-    constexpr matrix_impl(const M& m) noexcept
-        : matrix_impl{}
+    template <typename T1, int ... values>
+    friend class matrix_view;
+
+    template <typename T1, int ... values>
+    friend class matrix_impl;
+
+private:
+    constexpr bool is_consistent_check() const noexcept
     {
-        static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
-        static_assert(is_continuous);
-        if (std::get<0>(M::sizes) == 1) {
-            for (auto i = 0; i < size; ++i) {
-                operator[](i) = m[0];
+        return true;
+    }
+
+    template <typename M>
+    constexpr void assign(const M& m) noexcept
+    {
+        if constexpr (is_matrix<M>) {
+            static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
+            if (std::get<0>(M::sizes) == 1) {
+                for (auto i = 0; i < size; ++i) {
+                    operator[](i) = m[0];
+                }
+            } else {
+                for (auto i = 0; i < size; ++i) {
+                    operator[](i) = m[i];
+                }
             }
         } else {
             for (auto i = 0; i < size; ++i) {
-                operator[](i) = m[i];
+                operator[](i) = m;
             }
         }
         assert(is_consistent_check());
     }
 
-    constexpr matrix_impl(matrix_impl&& m) noexcept
-        : data_{m.data_}
-        , allocated_{m.allocated_}
+    /// @brief Views don't own their elements, so there is nothing to copy before they are mutated.
+    constexpr void detach() const noexcept
     {
-        m.allocated_ = false;
-        assert(is_consistent_check());
-        assert(m.is_consistent_check());
     }
 
-    constexpr explicit matrix_impl(std::nullptr_t) noexcept
-        : data_{nullptr}
-        , allocated_{false}
+    T* data_;
+};
+
+template <typename T, int abs_size, int abs_offset, int offset, int size>
+struct matrix_view<T, abs_size, abs_offset, offset, size>
+{
+    /// @name Properties
+    /// @{
+    static constexpr inline bool is_consistent = abs_size >= 0 &&
+                                                 abs_offset >= 0 &&
+                                                 offset >= 0 &&
+                                                 size >= 0 &&
+                                                 offset + size <= abs_size;
+    static_assert(is_consistent);
+
+    static constexpr inline int dimensions = 1;
+
+    static constexpr inline int64_t volume = size;
+
+    static constexpr inline int64_t absolute_volume = abs_size;
+
+    /// @brief Elements spanned by the stride of the axis, raw offsets are below it.
+    static constexpr inline int64_t absolute_extent = int64_t{abs_size} * abs_offset;
+
+    static constexpr inline auto sizes = std::make_tuple(size);
+
+    static constexpr inline auto offsets = std::make_tuple(offset);
+
+    static constexpr inline auto absolute_sizes = std::make_tuple(abs_size);
+
+    static constexpr inline auto absolute_offsets = std::make_tuple(abs_offset);
+
+    static constexpr inline bool is_cropped = (offset != 0 || size != abs_size);
+
+    static constexpr inline bool axes_swapped = (abs_offset != 1);
+
+    static constexpr inline bool is_continuous = ((!is_cropped) && (!axes_swapped));
+
+    /// @brief Whether owned matrices keep their elements inline instead of allocating them.
+    static constexpr inline bool is_inline = absolute_volume * sizeof(T) <= inline_bytes;
+    /// @}
+
+    /// @name Utilities
+    /// @{
+    /// @brief Type of the elements, without the const of views of const elements.
+    using value_type = std::remove_const_t<T>;
+
+    /// @brief Matrix type with the same sizes and strides, which may own its elements.
+    using matrix_type = matrix_impl<T, abs_size, abs_offset, offset, size>;
+
+    using view_type = matrix_view;
+
+    /// @brief View of the same elements that can't write to them, returned by const access to owned matrices.
+    using const_view_type = matrix_view<const T, abs_size, abs_offset, offset, size>;
+
+    using iterator = std::conditional_t<is_continuous, T*, impl::strided_iterator<matrix_view, T>>;
+
+    using const_iterator = std::conditional_t<is_continuous, const T*, impl::strided_iterator<matrix_view, const T>>;
+
+    /// @brief Type of raw offsets: int, std::ptrdiff_t only when they don't fit into it.
+    using index_type = impl::offset_type<absolute_extent>;
+
+    static constexpr inline index_type raw_offset(int h) noexcept
     {
-        static_assert(is_continuous);
-        assert(is_consistent_check());
+        return index_type{h + offset} * abs_offset;
     }
 
-    constexpr explicit matrix_impl() noexcept
-        : data_{new T[absolute_volume]{}}
-        , allocated_{true}
+    template <int new_offset, int new_size>
+    using cropped_matrix_type = matrix_view<T, abs_size, abs_offset, offset + new_offset, new_size>;
+
+    template <int ... slices>
+    using sliced_matrix_type = typename matrix_view_type<typename impl::sliced_matrix_type<matrix_type, slices ...>::type
+                                                        >::type;
+
+    using continuous_matrix_type = impl::continuous_matrix_type_from_matrix<matrix_type>;
+
+    template <typename U>
+    using cast_matrix_type = impl::continuous_matrix_type_from_matrix<typename matrix_rebind_type<U, matrix_type>::type>;
+
+    template <typename F>
+    using map_matrix_type = cast_matrix_type<std::remove_cvref_t<std::invoke_result_t<const F&, const T&>>>;
+
+    template <typename M>
+    using max_size_matrix_type = typename max_size_matrix_type_impl<matrix_type, typename M::matrix_type>::type;
+
+    template <typename M, typename F>
+    using zip_matrix_type = typename matrix_rebind_type<
+        std::remove_cvref_t<std::invoke_result_t<const F&, const T&, const typename M::value_type&>>,
+        max_size_matrix_type<M>>::type;
+
+    using mask_type = cast_matrix_type<bool>;
+
+    template <int axis, int new_size, typename U = value_type>
+    using resized_matrix_type = typename impl::resized_matrix_type<U, axis, new_size, matrix_view>::type;
+    /// @}
+
+    /// @name Construction & Destruction
+    /// @{
+    constexpr matrix_view(std::span<T, absolute_volume> d) noexcept
+        : data_{d.data()}
     {
-        static_assert(is_continuous);
         assert(is_consistent_check());
     }
 
-    constexpr explicit matrix_impl(const T& v) noexcept
-        : matrix_impl{}
+    constexpr matrix_view(T* s, T* e) noexcept
+        : matrix_view(std::span<T, absolute_volume>{s, e})
     {
-        std::fill(data_, data_ + absolute_volume, v);
+        assert(std::distance(s, e) == absolute_volume);
         assert(is_consistent_check());
     }
 
-    constexpr matrix_impl(T* s, T* e) noexcept
-        : matrix_impl(std::span<T, absolute_volume>{s, e})
+    constexpr explicit matrix_view(std::nullptr_t) noexcept
+        : data_{nullptr}
     {
-        assert(std::distance(s, e) == absolute_volume);
-        assert(is_consistent_check());
     }
 
-    ~matrix_impl() noexcept
+    /// @brief View of const elements over the elements of a view.
+    template <typename U>
+        requires std::is_same<const U, T>::value && (!std::is_same<U, T>::value)
+    constexpr matrix_view(const matrix_view<U, abs_size, abs_offset, offset, size>& m) noexcept
+        : data_{m.data_}
     {
-        if (allocated_) {
-            delete[] data_;
-        }
     }
 
-    constexpr matrix_impl& operator=(const matrix_impl& m) noexcept
+    /// @brief View of the elements of an owned matrix, which copies them first when they are shared as the view may
+    /// write to them.
+    constexpr matrix_view(matrix_impl<value_type, abs_size, abs_offset, offset, size>& m) noexcept
+        requires (!std::is_const<T>::value)
+        : data_{m.data()}
     {
-        if (this != (&m)) {
-            for (auto i = 0; i < size; ++i) {
-                operator[](i) = m[i];
-            }
-        }
-        assert(is_consistent_check());
-        return *this;
     }
 
-    constexpr matrix_impl& operator=(matrix_impl&& m) noexcept
+    /// @brief View of const elements over the elements of an owned matrix, even a shared one.
+    constexpr matrix_view(const matrix_impl<value_type, abs_size, abs_offset, offset, size>& m) noexcept
+        requires std::is_const<T>::value
+        : data_{m.data()}
     {
-        if (allocated_) {
-            delete[] data_;
-        }
-        data_ = m.data_;
-        allocated_ = m.allocated_;
-        m.allocated_ = false;
-        assert(is_consistent_check());
-        assert(m.is_consistent_check());
+    }
+
+    constexpr matrix_view(const matrix_view& m) noexcept = default;
+
+    constexpr matrix_view(matrix_view&& m) noexcept = default;
+
+    constexpr matrix_view& operator=(const matrix_view& m) & noexcept
+    {
+        assign(m);
         return *this;
     }
 
-    constexpr matrix_impl& operator=(const T& v) noexcept
+    template <typename M>
+    constexpr matrix_view& operator=(const M& m) & noexcept
     {
-        for (auto i = 0; i < size; ++i) {
-            operator[](i) = v;
-        }
-        assert(is_consistent_check());
+        assign(m);
         return *this;
     }
 
     template <typename M>
-    constexpr matrix_impl& operator=(const M& m) noexcept
+    constexpr matrix_view& operator=(const M& m) && noexcept
     {
-        static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
-        if (std::get<0>(M::sizes) == 1) {
-            for (auto i = 0; i < size; ++i) {
-                operator[](i) = m[0];
-            }
-        } else {
-            for (auto i = 0; i < size; ++i) {
-                operator[](i) = m[i];
-            }
-        }
-        assert(is_consistent_check());
+        assign(m);
         return *this;
     }
 
+    constexpr void rebind(const matrix_view& m) noexcept
+    {
+        data_ = m.data_;
+    }
+
+    /// @brief Writes the matrix to a file: a 64 byte header with the element type, byte order and sizes followed by
+    /// the elements in row major order. False on failure.
+    bool save(const char* path) const noexcept
+    {
+        return impl::save(*this, path, false);
+    }
+
+    /// @brief Writes the matrix to a NumPy .npy file. False on failure.
+    bool save_npy(const char* path) const noexcept
+    {
+        return impl::save(*this, path, true);
+    }
+
+    /// @brief Reads a matrix written by save, null if the element type or the sizes don't match.
+    static continuous_matrix_type load(const char* path) noexcept
+    {
+        return impl::load<continuous_matrix_type>(path, false);
+    }
+
+    /// @brief Reads a C order NumPy .npy file, null if the element type or the shape don't match.
+    static continuous_matrix_type load_npy(const char* path) noexcept
+    {
+        return impl::load<continuous_matrix_type>(path, true);
+    }
+
     constexpr continuous_matrix_type copy() const noexcept
     {
-        if (allocated_) {
-            return continuous_matrix_type{*this};
-        }
-        continuous_matrix_type r;
+        continuous_matrix_type r{uninitialized};
         r = *this;
         return r;
     }
+
+    template <typename U, bool saturate = false>
+    constexpr cast_matrix_type<U> cast() const noexcept
+    {
+        cast_matrix_type<U> r{uninitialized};
+        cast_into<saturate>(r);
+        return r;
+    }
+
+    template <bool saturate = false, typename M>
+    constexpr void cast_into(M&& m) const noexcept
+    {
+        using R = std::remove_cvref_t<M>;
+        static_assert(sizes == R::sizes);
+        m.detach();
+        cast_calculator<matrix_view, typename R::view_type, saturate>::calculate(*this, m);
+        assert(is_consistent_check());
+    }
     /// @}
 
     /// @name Crop Reshape
     /// @{
     template <int new_offset, int new_size>
-    constexpr cropped_matrix_type<new_offset, new_size> crop() const& noexcept
+    constexpr cropped_matrix_type<new_offset, new_size> crop() const noexcept
     {
         return cropped_matrix_type<new_offset, new_size>{data_, data_ + absolute_volume};
     }
 
-    template <int new_offset, int new_size, int ... new_tail>
-    constexpr cropped_matrix_type<new_offset, new_size> crop() && noexcept
+    template <int slice_offset, int slice_size, int step>
+    constexpr sliced_matrix_type<slice_offset, slice_size, step> slice() const noexcept
     {
-        auto r = cropped_matrix_type<new_offset, new_size>{data_, data_ + absolute_volume};
-        r.allocated_ = allocated_;
-        allocated_ = false;
-        return r;
+        using R = sliced_matrix_type<slice_offset, slice_size, step>;
+        constexpr auto shift = impl::sliced_matrix_type<matrix_type, slice_offset, slice_size, step>::shift;
+        return R{data_ + shift, data_ + shift + R::absolute_volume};
     }
 
     template <int ... sizes>
-    constexpr continuous_matrixd<T, sizes ...> reshape() const& noexcept
+    constexpr auto reshape() const noexcept
     {
-        static_assert(continuous_matrixd<T, sizes ...>::volume == volume);
-        static_assert(!is_cropped, "Can't reshape cropped matrix");
-        return continuous_matrixd<T, sizes ...>{data_, data_ + volume};
+        static_assert(continuous_matrixd<value_type, sizes ...>::volume == volume);
+        if constexpr (is_continuous) {
+            using V = typename matrix_view_type<continuous_matrixd<T, sizes ...>>::type;
+            return V{data_, data_ + volume};
+        } else {
+            using R = impl::reshaped_matrix_type<matrix_type, sizes ...>;
+            static_assert(R::is_view, "Can't reshape the matrix without a copy, use reshape_copy()");
+            using V = typename matrix_view_type<typename R::type>::type;
+            return V{data_ + R::shift, data_ + R::shift + V::absolute_volume};
+        }
     }
 
     template <int ... sizes>
-    constexpr continuous_matrixd<T, sizes ...> reshape() && noexcept
+    constexpr continuous_matrixd<value_type, sizes ...> reshape_copy() const noexcept
     {
-        static_assert(continuous_matrixd<T, sizes ...>::volume == volume);
-        static_assert(!is_cropped, "Can't reshape cropped matrix");
-        auto r = continuous_matrixd<T, sizes ...>{data_, data_ + volume};
-        r.allocated_ = allocated_;
-        allocated_ = false;
-        return r;
+        return copy().template reshape<sizes ...>();
     }
+
     /// @}
 
     /// @name Element Access
@@ -861,33 +1179,33 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size>
     {
         assert(index < size && index >= 0);
         assert(is_consistent_check());
-        return data_[(index + offset) * abs_offset];
+        return data_[raw_offset(index)];
     }
 
     constexpr const T& operator[](int index) const noexcept
     {
         assert(index < size && index >= 0);
-        return data_[(index + offset) * abs_offset];
+        return data_[raw_offset(index)];
     }
 
     constexpr T& at(int index) noexcept
     {
-        assert(raw_offset(index) < absolute_volume);
+        assert(raw_offset(index) < absolute_extent);
         assert(is_consistent_check());
-        return data_[(index + offset) * abs_offset];
+        return data_[raw_offset(index)];
     }
 
     constexpr const T& at(int index) const noexcept
     {
-        assert(raw_offset(index) < absolute_volume);
-        return data_[(index + offset) * abs_offset];
+        assert(raw_offset(index) < absolute_extent);
+        return data_[raw_offset(index)];
     }
     /// @}
 
     /// @name Operations
     /// @{
     template <typename M>
-    constexpr matrix_impl& operator+=(const M& m) noexcept
+    constexpr matrix_view& operator+=(const M& m) noexcept
     {
         static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
         if (std::get<0>(M::sizes) == 1) {
@@ -903,7 +1221,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size>
         return *this;
     }
 
-    constexpr matrix_impl& operator+=(const T& v) noexcept
+    constexpr matrix_view& operator+=(const T& v) noexcept
     {
         for (auto i = 0; i < size; ++i) {
             operator[](i) += v;
@@ -913,7 +1231,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size>
     }
 
     template <typename M>
-    constexpr matrix_impl& operator-=(const M& m) noexcept
+    constexpr matrix_view& operator-=(const M& m) noexcept
     {
         static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
         if (std::get<0>(M::sizes) == 1) {
@@ -929,7 +1247,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size>
         return *this;
     }
 
-    constexpr matrix_impl& operator-=(const T& v) noexcept
+    constexpr matrix_view& operator-=(const T& v) noexcept
     {
         for (auto i = 0; i < size; ++i) {
             operator[](i) -= v;
@@ -939,7 +1257,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size>
     }
 
     template <typename M>
-    constexpr matrix_impl& operator*=(const M& m) noexcept
+    constexpr matrix_view& operator*=(const M& m) noexcept
     {
         static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
         if (std::get<0>(M::sizes) == 1) {
@@ -955,7 +1273,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size>
         return *this;
     }
 
-    constexpr matrix_impl& operator*=(const T& v) noexcept
+    constexpr matrix_view& operator*=(const T& v) noexcept
     {
         for (auto i = 0; i < size; ++i) {
             operator[](i) *= v;
@@ -965,7 +1283,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size>
     }
 
     template <typename M>
-    constexpr matrix_impl& operator/=(const M& m) noexcept
+    constexpr matrix_view& operator/=(const M& m) noexcept
     {
         static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
         if (std::get<0>(M::sizes) == 1) {
@@ -981,7 +1299,7 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size>
         return *this;
     }
 
-    constexpr matrix_impl& operator/=(const T& v) noexcept
+    constexpr matrix_view& operator/=(const T& v) noexcept
     {
         for (auto i = 0; i < size; ++i) {
             operator[](i) /= v;
@@ -990,12 +1308,12 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size>
         return *this;
     }
 
-    template <int ... sizes_and_offsets>
-    constexpr auto operator+(const matrix_impl<T, sizes_and_offsets ...>& m) const noexcept -> max_size_matrix_type<matrix_impl<T, sizes_and_offsets ...>>
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto operator+(const M& m) const noexcept -> max_size_matrix_type<M>
     {
-        using M = matrix_impl<T, sizes_and_offsets ...>;
         static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
-        max_size_matrix_type<M> mm = copy();
+        auto mm = promoted_copy<max_size_matrix_type<M>>(*this);
         mm += m;
         return mm;
     }
@@ -1007,12 +1325,12 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size>
         return mm;
     }
 
-    template <int ... sizes_and_offsets>
-    constexpr auto operator-(const matrix_impl<T, sizes_and_offsets ...>& m) const noexcept -> max_size_matrix_type<matrix_impl<T, sizes_and_offsets ...>>
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto operator-(const M& m) const noexcept -> max_size_matrix_type<M>
     {
-        using M = matrix_impl<T, sizes_and_offsets ...>;
         static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
-        max_size_matrix_type<M> mm = copy();
+        auto mm = promoted_copy<max_size_matrix_type<M>>(*this);
         mm -= m;
         return mm;
     }
@@ -1024,14 +1342,13 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size>
         return mm;
     }
 
-    template <int ... sizes_and_offsets>
-    constexpr auto operator*(const matrix_impl<T, sizes_and_offsets ...>& m) const noexcept -> max_size_matrix_type<matrix_impl<T, sizes_and_offsets ...>>
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto operator*(const M& m) const noexcept -> max_size_matrix_type<M>
     {
-        using M = matrix_impl<T, sizes_and_offsets ...>;
         static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
-        max_size_matrix_type<M> mm = copy();
+        auto mm = promoted_copy<max_size_matrix_type<M>>(*this);
         mm *= m;
-        static_assert(std::get<0>(mm.sizes) == 3);
         return mm;
     }
 
@@ -1042,12 +1359,12 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size>
         return mm;
     }
 
-    template <int ... sizes_and_offsets>
-    constexpr auto operator/(const matrix_impl<T, sizes_and_offsets ...>& m) const noexcept -> max_size_matrix_type<matrix_impl<T, sizes_and_offsets ...>>
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto operator/(const M& m) const noexcept -> max_size_matrix_type<M>
     {
-        using M = matrix_impl<T, sizes_and_offsets ...>;
         static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
-        max_size_matrix_type<M> mm = copy();
+        auto mm = promoted_copy<max_size_matrix_type<M>>(*this);
         mm /= m;
         return mm;
     }
@@ -1062,80 +1379,1785 @@ struct matrix_impl<T, abs_size, abs_offset, offset, size>
     constexpr continuous_matrix_type sqrt() const noexcept
     {
         auto mm = copy();
-        impl::sqrt_calculator<continuous_matrix_type>::calculate(mm);
+        mm.map_inplace([](const T& v) { return static_cast<T>(std::sqrt(v)); });
         return mm;
     }
-    /// @}
 
-    /// @name Comparison
-    /// @{
-    constexpr bool operator==(const matrix_impl& m) const noexcept
+    /// Big matrices are processed in parallel, so f must be safe to call concurrently.
+    template <typename F>
+    constexpr map_matrix_type<F> map(const F& f) const noexcept
     {
-        if (data_ == m.data_) {
-            return true;
-        }
-        for (auto i = 0; i < size; ++i) {
-            if (operator[](i) != m[i]) {
-                return false;
-            }
-        }
-        return true;
+        map_matrix_type<F> r{uninitialized};
+        element_wise([&f](auto& o, const T& v) { o = f(v); }, r, *this);
+        return r;
     }
 
-    template <typename M>
-    constexpr bool operator==(const M& m) const noexcept
+    template <typename F>
+    constexpr matrix_view& map_inplace(const F& f) noexcept
     {
-        static_assert(sizes == M::sizes);
-        for (auto i = 0; i < size; ++i) {
-            if (operator[](i) != m[i]) {
-                return false;
-            }
-        }
-        return true;
+        element_wise([&f](T& v) { v = f(v); }, *this);
+        assert(is_consistent_check());
+        return *this;
     }
 
-    constexpr bool operator==(std::nullptr_t) const noexcept
+    template <typename M, typename F>
+    constexpr zip_matrix_type<M, F> zip_with(const M& m, const F& f) const noexcept
     {
-        return data_ == nullptr;
+        zip_matrix_type<M, F> r{uninitialized};
+        element_wise([&f](auto& o, const T& a, const auto& b) { o = f(a, b); }, r, *this, m);
+        return r;
     }
 
-    template <typename M>
-    constexpr bool operator!=(const M& m) const noexcept
+    template <typename M, typename F>
+    constexpr matrix_view& zip_with_inplace(const M& m, const F& f) noexcept
     {
-        return !((*this) == m);
+        static_assert(max_size_matrix_type<M>::sizes == sizes);
+        element_wise([&f](T& a, const auto& b) { a = f(a, b); }, *this, m);
+        assert(is_consistent_check());
+        return *this;
     }
-    /// @}
 
-    /// @name Access to data.
-    /// @{
-    T* data() noexcept
+    /// Calls f(element, indices ...) for every element.
+    template <typename F>
+    constexpr void for_each_indexed(const F& f) noexcept
     {
-        return data_;
+        indexed_calculator<matrix_view, (volume > crit_compl)>::calculate(f, *this);
     }
 
-    const T* data() const noexcept
+    template <typename F>
+    constexpr void for_each_indexed(const F& f) const noexcept
     {
-        return data_;
+        indexed_calculator<matrix_view, (volume > crit_compl)>::calculate(f, *this);
     }
-    /// @}
 
-    template <typename T1, int ... values>
-    friend class matrix_impl;
+    template <int axis, typename Op = std::plus<>, bool inclusive = true>
+    constexpr continuous_matrix_type scan(const Op& op = Op{}) const noexcept
+    {
+        auto r = copy();
+        scan_along<axis, inclusive>(r, op);
+        return r;
+    }
 
-private:
-    constexpr bool is_consistent_check() const noexcept
+    template <int axis>
+    constexpr continuous_matrix_type cumsum() const noexcept
     {
-        return true;
+        return scan<axis, std::plus<>>();
     }
 
-private:
-    T* data_;
-    bool allocated_;
-};
+    template <int axis>
+    constexpr continuous_matrix_type cumprod() const noexcept
+    {
+        return scan<axis, std::multiplies<>>();
+    }
+
+    template <int axis, int k, typename Compare = std::greater<>>
+    constexpr auto topk(const Compare& comp = Compare{}) const noexcept
+        -> std::pair<resized_matrix_type<axis, k>, resized_matrix_type<axis, k, int>>
+    {
+        return topk_along<axis, k>(*this, comp);
+    }
+
+    template <int axis>
+    constexpr resized_matrix_type<axis, 1, int> argmax() const noexcept
+    {
+        return topk<axis, 1>().second;
+    }
+
+    template <int axis>
+    constexpr resized_matrix_type<axis, 1, int> argmin() const noexcept
+    {
+        return topk<axis, 1, std::less<>>().second;
+    }
+
+    template <typename D>
+    constexpr matrix_view& fill_random(uint64_t seed, const D& distribution = D{}) noexcept
+    {
+        random_fill(*this, seed, distribution);
+        assert(is_consistent_check());
+        return *this;
+    }
+
+    constexpr continuous_matrix_type clamp(const T& lo, const T& hi) const noexcept
+    {
+        return map([lo, hi](const T& v) { return v < lo ? lo : (hi < v ? hi : v); });
+    }
+
+    template <typename M>
+    constexpr auto min(const M& m) const noexcept
+    {
+        return zip_with(m, [](const T& a, const auto& b) { return b < a ? b : a; });
+    }
+
+    constexpr continuous_matrix_type min(const T& v) const noexcept
+    {
+        return map([v](const T& a) { return v < a ? v : a; });
+    }
+
+    template <typename M>
+    constexpr auto max(const M& m) const noexcept
+    {
+        return zip_with(m, [](const T& a, const auto& b) { return a < b ? b : a; });
+    }
+
+    constexpr continuous_matrix_type max(const T& v) const noexcept
+    {
+        return map([v](const T& a) { return a < v ? v : a; });
+    }
+    /// @}
+
+    /// @name Comparison
+    /// @{
+    constexpr bool operator==(const matrix_view& m) const noexcept
+    {
+        if (data_ == m.data_) {
+            return true;
+        }
+        for (auto i = 0; i < size; ++i) {
+            if (operator[](i) != m[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename M>
+    constexpr bool operator==(const M& m) const noexcept
+    {
+        static_assert(sizes == M::sizes);
+        for (auto i = 0; i < size; ++i) {
+            if (operator[](i) != m[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr bool operator==(std::nullptr_t) const noexcept
+    {
+        return data_ == nullptr;
+    }
+
+    template <typename M>
+    constexpr bool operator!=(const M& m) const noexcept
+    {
+        return !((*this) == m);
+    }
+
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto operator<(const M& m) const noexcept
+    {
+        return zip_with(m, [](const T& a, const auto& b) -> bool { return a < b; });
+    }
+
+    constexpr mask_type operator<(const T& v) const noexcept
+    {
+        return map([v](const T& a) -> bool { return a < v; });
+    }
+
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto operator<=(const M& m) const noexcept
+    {
+        return zip_with(m, [](const T& a, const auto& b) -> bool { return a <= b; });
+    }
+
+    constexpr mask_type operator<=(const T& v) const noexcept
+    {
+        return map([v](const T& a) -> bool { return a <= v; });
+    }
+
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto operator>(const M& m) const noexcept
+    {
+        return zip_with(m, [](const T& a, const auto& b) -> bool { return a > b; });
+    }
+
+    constexpr mask_type operator>(const T& v) const noexcept
+    {
+        return map([v](const T& a) -> bool { return a > v; });
+    }
+
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto operator>=(const M& m) const noexcept
+    {
+        return zip_with(m, [](const T& a, const auto& b) -> bool { return a >= b; });
+    }
+
+    constexpr mask_type operator>=(const T& v) const noexcept
+    {
+        return map([v](const T& a) -> bool { return a >= v; });
+    }
+
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto equal(const M& m) const noexcept
+    {
+        return zip_with(m, [](const T& a, const auto& b) -> bool { return a == b; });
+    }
+
+    constexpr mask_type equal(const T& v) const noexcept
+    {
+        return map([v](const T& a) -> bool { return a == v; });
+    }
+
+    template <typename M>
+        requires is_matrix<M>
+    constexpr auto not_equal(const M& m) const noexcept
+    {
+        return zip_with(m, [](const T& a, const auto& b) -> bool { return a != b; });
+    }
+
+    constexpr mask_type not_equal(const T& v) const noexcept
+    {
+        return map([v](const T& a) -> bool { return a != v; });
+    }
+    /// @}
+
+    /// @name Iterators
+    /// Standard algorithms, including the parallel ones, apply to the elements in row major order.
+    /// @{
+    constexpr iterator begin() noexcept
+    {
+        if constexpr (is_continuous) {
+            return data_;
+        } else {
+            return iterator{data_, 0};
+        }
+    }
+
+    constexpr iterator end() noexcept
+    {
+        if constexpr (is_continuous) {
+            return data_ + volume;
+        } else {
+            return iterator{data_, volume};
+        }
+    }
+
+    constexpr const_iterator begin() const noexcept
+    {
+        if constexpr (is_continuous) {
+            return data_;
+        } else {
+            return const_iterator{data_, 0};
+        }
+    }
+
+    constexpr const_iterator end() const noexcept
+    {
+        if constexpr (is_continuous) {
+            return data_ + volume;
+        } else {
+            return const_iterator{data_, volume};
+        }
+    }
+    /// @}
+
+    /// @name Access to data.
+    /// @{
+    T* data() noexcept
+    {
+        return data_;
+    }
+
+    const T* data() const noexcept
+    {
+        return data_;
+    }
+
+#if defined(__cpp_lib_mdspan)
+    /// @brief std::mdspan over the elements with static extents and layout_stride, without copying.
+    constexpr auto to_mdspan() noexcept
+    {
+        return impl::mdspan_type_impl<matrix_view, T>::make(data_);
+    }
+
+    constexpr auto to_mdspan() const noexcept
+    {
+        return impl::mdspan_type_impl<matrix_view, const T>::make(data_);
+    }
+#endif
+    /// @}
+
+    template <typename T1, int ... values>
+    friend class matrix_view;
+
+    template <typename T1, int ... values>
+    friend class matrix_impl;
+
+private:
+    constexpr bool is_consistent_check() const noexcept
+    {
+        return true;
+    }
+
+    template <typename M>
+    constexpr void assign(const M& m) noexcept
+    {
+        if constexpr (is_matrix<M>) {
+            static_assert(size == std::get<0>(M::sizes) || size == 1 || std::get<0>(M::sizes) == 1);
+            if (std::get<0>(M::sizes) == 1) {
+                for (auto i = 0; i < size; ++i) {
+                    operator[](i) = m[0];
+                }
+            } else {
+                for (auto i = 0; i < size; ++i) {
+                    operator[](i) = m[i];
+                }
+            }
+        } else {
+            for (auto i = 0; i < size; ++i) {
+                operator[](i) = m;
+            }
+        }
+        assert(is_consistent_check());
+    }
+
+    /// @brief Views don't own their elements, so there is nothing to copy before they are mutated.
+    constexpr void detach() const noexcept
+    {
+    }
+
+    T* data_;
+};
+
+/// @brief Matrix owning its elements: allocated from a memory resource, kept inline when small or shared copy on
+/// write. Element access, crop() and swap_axes() of lvalues return views. Matrices made over
+/// existing elements don't own them and behave like views.
+/// The view is a private base, so every way to a view that can write goes through detach(): non-const access and
+/// conversion to view_type copy shared elements first, const access returns views of const elements.
+template <typename T, int ... sizes_and_offsets>
+struct matrix_impl : private matrix_view<T, sizes_and_offsets ...>
+{
+    using base = matrix_view<T, sizes_and_offsets ...>;
+
+    /// @name Properties
+    /// @{
+    using base::is_consistent;
+    using base::dimensions;
+    using base::volume;
+    using base::absolute_volume;
+    using base::absolute_extent;
+    using base::sizes;
+    using base::offsets;
+    using base::absolute_sizes;
+    using base::absolute_offsets;
+    using base::is_cropped;
+    using base::axes_swapped;
+    using base::is_continuous;
+    using base::is_inline;
+
+    /// @brief Byte alignment of data() of owned matrices. Views don't define it: the elements of a row, crop or
+    /// slice may start anywhere in the storage.
+    static constexpr inline std::size_t alignment = impl::inline_storage<T, absolute_volume>::alignment;
+
+    /// @}
+
+    /// @name Utilities
+    /// @{
+    using typename base::value_type;
+
+    using typename base::matrix_type;
+
+    using typename base::view_type;
+
+    using typename base::const_view_type;
+
+    using typename base::iterator;
+
+    using typename base::const_iterator;
+
+    using typename base::index_type;
+
+    using base::raw_offset;
+
+    template <int i, int j>
+    using swap_axes_matrix_type = typename matrix_swap_axes_type<i, j, matrix_impl>::type;
+
+    template <int index_count>
+    using submatrix_type = typename impl::submatrix_type<matrix_impl, index_count>::type;
+
+    template <int new_offset, int new_size, int ... new_tail>
+    using cropped_matrix_type = typename impl::cropped_matrix_type<matrix_impl, new_offset, new_size, new_tail ...>::type;
+
+    template <int ... slices>
+    using sliced_matrix_type = typename base::template sliced_matrix_type<slices ...>;
+
+    template <typename M>
+    using dot_product_type = typename dot_product_matrix_type_impl<matrix_impl, typename M::matrix_type>::type;
+
+    template <typename M>
+    using max_size_matrix_type = typename base::template max_size_matrix_type<M>;
+
+    using continuous_matrix_type = typename base::continuous_matrix_type;
+
+    template <typename U>
+    using cast_matrix_type = typename base::template cast_matrix_type<U>;
+
+    template <typename F>
+    using map_matrix_type = typename base::template map_matrix_type<F>;
+
+    template <typename M, typename F>
+    using zip_matrix_type = typename base::template zip_matrix_type<M, F>;
+
+    using typename base::mask_type;
+
+    template <int axis, int new_size, typename U = value_type>
+    using resized_matrix_type = typename base::template resized_matrix_type<axis, new_size, U>;
+    /// @}
+
+    /// @name Construction & Destruction
+    /// @{
+    constexpr matrix_impl(std::span<T, absolute_volume> d) noexcept
+        : base{d}
+        , resource_{nullptr}
+        , shared_{nullptr}
+    {
+    }
+
+    /// @brief Owned matrix adopting elements allocated from the memory resource r.
+    constexpr matrix_impl(std::span<T, absolute_volume> d, std::pmr::memory_resource* r) noexcept
+        : base{d}
+        , resource_{r}
+        , shared_{nullptr}
+    {
+        static_assert(is_continuous);
+    }
+
+    constexpr matrix_impl(T* s, T* e) noexcept
+        : matrix_impl(std::span<T, absolute_volume>{s, e})
+    {
+        assert(std::distance(s, e) == absolute_volume);
+    }
+
+    /// @brief Matrix over the elements of the view, which it doesn't own.
+    constexpr matrix_impl(const base& v) noexcept
+        : base{v}
+        , resource_{nullptr}
+        , shared_{nullptr}
+    {
+    }
+
+    constexpr matrix_impl(const matrix_impl& m) noexcept
+        : base{static_cast<const base&>(m)}
+        , resource_{nullptr}
+        , shared_{m.shared_}
+    {
+        if (shared_ != nullptr) {
+            resource_ = m.resource_;
+            shared_->count.fetch_add(1, std::memory_order_relaxed);
+        } else if (m.owns()) {
+            assert(is_continuous);
+            resource_ = is_inline ? nullptr : current_memory_resource();
+            this->data_ = allocate_storage<false>(resource_);
+            std::copy(m.data_, m.data_ + absolute_volume, this->data_);
+        }
+    }
+
+    template <typename M>
+        requires impl::is_matrix<M>
+    constexpr matrix_impl(const M& m) noexcept
+        : matrix_impl{}
+    {
+        static_assert(is_continuous);
+        this->assign(m);
+    }
+
+    /// @brief Takes over the storage of m. Elements kept inline are copied instead: views, data() pointers and
+    /// iterators taken from m keep referring to m, not to the new matrix, while those of allocated storage stay valid.
+    constexpr matrix_impl(matrix_impl&& m) noexcept
+        : base{static_cast<const base&>(m)}
+        , resource_{m.resource_}
+        , shared_{m.shared_}
+    {
+        m.shared_ = nullptr;
+        if (m.owns_inline()) {
+            this->data_ = inline_.data();
+            std::copy(m.data_, m.data_ + absolute_volume, this->data_);
+        }
+        m.resource_ = nullptr;
+    }
+
+    constexpr explicit matrix_impl(std::nullptr_t) noexcept
+        : base{nullptr}
+        , resource_{nullptr}
+        , shared_{nullptr}
+    {
+        static_assert(is_continuous);
+    }
+
+    constexpr explicit matrix_impl() noexcept
+        : matrix_impl{current_memory_resource()}
+    {
+    }
+
+    /// @brief Owned matrix with uninitialized elements, for outputs overwritten as a whole.
+    constexpr explicit matrix_impl(uninitialized_t, std::pmr::memory_resource* r = current_memory_resource()) noexcept
+        : base{nullptr}
+        , resource_{is_inline ? nullptr : r}
+        , shared_{nullptr}
+    {
+        static_assert(is_continuous);
+        this->data_ = allocate_storage<false>(r);
+    }
+
+    /// @brief Owned matrix allocated from the given memory resource, which should outlive it.
+    constexpr explicit matrix_impl(std::pmr::memory_resource* r) noexcept
+        : base{nullptr}
+        , resource_{is_inline ? nullptr : r}
+        , shared_{nullptr}
+    {
+        static_assert(is_continuous);
+        this->data_ = allocate_storage<true>(r);
+    }
+
+    constexpr explicit matrix_impl(const T& v) noexcept
+        : matrix_impl{}
+    {
+        std::fill(this->data_, this->data_ + absolute_volume, v);
+    }
+
+    ~matrix_impl() noexcept
+    {
+        release();
+    }
+
+    constexpr matrix_impl& operator=(const matrix_impl& m) noexcept
+    {
+        if (this != (&m)) {
+            detach();
+            this->assign(m);
+        }
+        return *this;
+    }
+
+    /// @brief Takes over the storage of m, copying elements kept inline like the move constructor.
+    constexpr matrix_impl& operator=(matrix_impl&& m) noexcept
+    {
+        release();
+        if (m.owns_inline()) {
+            this->data_ = inline_.data();
+            resource_ = nullptr;
+            std::copy(m.data_, m.data_ + absolute_volume, this->data_);
+        } else {
+            this->data_ = m.data_;
+            resource_ = m.resource_;
+            shared_ = m.shared_;
+        }
+        m.resource_ = nullptr;
+        m.shared_ = nullptr;
+        return *this;
+    }
+
+    template <typename M>
+    constexpr matrix_impl& operator=(const M& m) noexcept
+    {
+        detach();
+        this->assign(m);
+        return *this;
+    }
+
+    /// @brief Only views may point to other elements: rebinding an owner would release its storage twice.
+    void rebind(const base&) = delete;
+
+#ifdef __unix__
+    /// @brief Matrix over the elements of a memory mapped matrix file, unmapped on destruction.
+    /// Null if the file can't be mapped or its element type and sizes don't match.
+    static matrix_impl map_file(const char* path,
+                                map_mode mode = map_mode::read_only,
+                                map_advice advice = map_advice::normal) noexcept
+    {
+        return impl::map_file<matrix_impl>(path, mode, advice);
+    }
+#endif
+
+    /// @brief Owned matrix sharing the elements with this one, both copy them on their first mutation.
+    /// Copies of either matrix share the elements as well. Views keep pointing to the elements they were made from.
+    constexpr matrix_impl share() noexcept
+    {
+        assert(owns());
+        if (resource_ != nullptr && shared_ == nullptr) {
+            shared_ = impl::make_shared_block(resource_);
+        }
+        return matrix_impl{*this};
+    }
+
+    constexpr continuous_matrix_type copy() const noexcept
+    {
+        if (owns()) {
+            return continuous_matrix_type{*this};
+        }
+        return base::copy();
+    }
+
+    using base::save;
+    using base::save_npy;
+    using base::load;
+    using base::load_npy;
+    using base::cast;
+    using base::cast_into;
+    using base::reshape_copy;
+    /// @}
+
+    /// @name Swap axes, Crop, Reshape
+    /// Views of lvalues write to the elements, so shared elements are copied first as for element access.
+    /// @{
+    template <int i, int j>
+    constexpr auto swap_axes() & noexcept
+    {
+        detach();
+        return base::template swap_axes<i, j>();
+    }
+
+    template <int i, int j>
+    constexpr auto swap_axes() const& noexcept
+    {
+        return const_view().template swap_axes<i, j>();
+    }
+
+    template <int i, int j>
+    constexpr swap_axes_matrix_type<i, j> swap_axes() && noexcept
+    {
+        swap_axes_matrix_type<i, j> r{base::template swap_axes<i, j>()};
+        transfer_ownership(r);
+        return r;
+    }
+
+    template <int new_offset, int new_size, int ... new_tail>
+    constexpr auto crop() & noexcept
+    {
+        detach();
+        return base::template crop<new_offset, new_size, new_tail ...>();
+    }
+
+    template <int new_offset, int new_size, int ... new_tail>
+    constexpr auto crop() const& noexcept
+    {
+        return const_view().template crop<new_offset, new_size, new_tail ...>();
+    }
+
+    template <int new_offset, int new_size, int ... new_tail>
+    constexpr cropped_matrix_type<new_offset, new_size, new_tail ...> crop() && noexcept
+    {
+        cropped_matrix_type<new_offset, new_size, new_tail ...> r{base::template crop<new_offset, new_size, new_tail ...>()};
+        transfer_ownership(r);
+        return r;
+    }
+
+    template <int ... slices>
+    constexpr auto slice() & noexcept
+    {
+        detach();
+        return base::template slice<slices ...>();
+    }
+
+    template <int ... slices>
+    constexpr auto slice() const& noexcept
+    {
+        return const_view().template slice<slices ...>();
+    }
+
+    /// @brief Slices of temporaries are copied, as their elements don't start at the owned pointer.
+    template <int ... slices>
+    constexpr auto slice() && noexcept
+    {
+        return base::template slice<slices ...>().copy();
+    }
+
+    template <int ... sizes>
+    constexpr auto reshape() & noexcept
+    {
+        detach();
+        return base::template reshape<sizes ...>();
+    }
+
+    template <int ... sizes>
+    constexpr auto reshape() const& noexcept
+    {
+        return const_view().template reshape<sizes ...>();
+    }
+
+    template <int ... sizes>
+    constexpr continuous_matrixd<T, sizes ...> reshape() && noexcept
+    {
+        if constexpr (base::is_continuous) {
+            continuous_matrixd<T, sizes ...> r{base::template reshape<sizes ...>()};
+            transfer_ownership(r);
+            return r;
+        } else {
+            return base::template reshape<sizes ...>().copy();
+        }
+    }
+    /// @}
+
+    /// @name Element Access
+    /// @{
+    constexpr decltype(auto) operator[](int index) noexcept
+    {
+        detach();
+        return base::operator[](index);
+    }
+
+    constexpr decltype(auto) operator[](int index) const noexcept
+    {
+        return const_view()[index];
+    }
+
+    template <typename ... I>
+    constexpr decltype(auto) at(I ... indices) noexcept
+    {
+        detach();
+        return base::at(indices ...);
+    }
+
+    template <typename ... I>
+    constexpr decltype(auto) at(I ... indices) const noexcept
+    {
+        return base::at(indices ...);
+    }
+
+    template <typename ... I>
+    constexpr auto sub(I ... indices) noexcept
+    {
+        detach();
+        return base::sub(indices ...);
+    }
+
+    template <typename ... I>
+    constexpr auto sub(I ... indices) const noexcept
+    {
+        return const_view().sub(indices ...);
+    }
+
+    T* data() noexcept
+    {
+        detach();
+        return this->data_;
+    }
+
+    const T* data() const noexcept
+    {
+        return this->data_;
+    }
+
+    constexpr auto begin() noexcept
+    {
+        detach();
+        return base::begin();
+    }
+
+    constexpr auto end() noexcept
+    {
+        detach();
+        return base::end();
+    }
+
+    constexpr auto begin() const noexcept
+    {
+        return base::begin();
+    }
+
+    constexpr auto end() const noexcept
+    {
+        return base::end();
+    }
+
+    template <int axis = 0>
+    constexpr auto axis_range() noexcept
+    {
+        detach();
+        return base::template axis_range<axis>();
+    }
+
+    template <int axis = 0>
+    constexpr auto axis_range() const noexcept
+    {
+        return const_view().template axis_range<axis>();
+    }
+
+#if defined(__cpp_lib_mdspan)
+    constexpr auto to_mdspan() noexcept
+    {
+        detach();
+        return base::to_mdspan();
+    }
+
+    constexpr auto to_mdspan() const noexcept
+    {
+        return base::to_mdspan();
+    }
+#endif
+    /// @}
+
+    /// @name Operations
+    /// @{
+    template <typename V>
+    constexpr matrix_impl& operator+=(const V& v) noexcept
+    {
+        detach();
+        base::operator+=(v);
+        return *this;
+    }
+
+    template <typename V>
+    constexpr matrix_impl& operator-=(const V& v) noexcept
+    {
+        detach();
+        base::operator-=(v);
+        return *this;
+    }
+
+    template <typename V>
+    constexpr matrix_impl& operator*=(const V& v) noexcept
+    {
+        detach();
+        base::operator*=(v);
+        return *this;
+    }
+
+    template <typename V>
+    constexpr matrix_impl& operator/=(const V& v) noexcept
+    {
+        detach();
+        base::operator/=(v);
+        return *this;
+    }
+
+    template <typename F>
+    constexpr matrix_impl& map_inplace(const F& f) noexcept
+    {
+        detach();
+        base::map_inplace(f);
+        return *this;
+    }
+
+    template <typename M, typename F>
+    constexpr matrix_impl& zip_with_inplace(const M& m, const F& f) noexcept
+    {
+        detach();
+        base::zip_with_inplace(m, f);
+        return *this;
+    }
+
+    template <typename F>
+    constexpr void for_each_indexed(const F& f) noexcept
+    {
+        detach();
+        base::for_each_indexed(f);
+    }
+
+    template <typename F>
+    constexpr void for_each_indexed(const F& f) const noexcept
+    {
+        base::for_each_indexed(f);
+    }
+
+    template <typename D>
+    constexpr matrix_impl& fill_random(uint64_t seed, const D& distribution = D{}) noexcept
+    {
+        detach();
+        base::fill_random(seed, distribution);
+        return *this;
+    }
+
+    template <typename M>
+    constexpr auto dot(const M& m) const noexcept -> dot_product_type<M>
+    {
+        return base::dot(m);
+    }
+
+    using base::operator+;
+    using base::operator-;
+    using base::operator*;
+    using base::operator/;
+    using base::sqrt;
+    using base::map;
+    using base::zip_with;
+    using base::scan;
+    using base::cumsum;
+    using base::cumprod;
+    using base::topk;
+    using base::argmax;
+    using base::argmin;
+    using base::clamp;
+    using base::min;
+    using base::max;
+    /// @}
+
+    /// @name Comparison
+    /// @{
+    using base::operator==;
+    using base::operator!=;
+    using base::operator<;
+    using base::operator<=;
+    using base::operator>;
+    using base::operator>=;
+    using base::equal;
+    using base::not_equal;
+    /// @}
+
+    template <typename T1, int ... values>
+    friend class matrix_view;
+
+    template <typename T1, int ... values>
+    friend class matrix_impl;
+
+private:
+    /// @brief View of the elements for const access, which can't write to them so shared elements aren't copied.
+    constexpr const_view_type const_view() const noexcept
+    {
+        return const_view_type{*this};
+    }
+
+    /// @brief Whether the matrix owns its elements, inline or allocated.
+    constexpr bool owns() const noexcept
+    {
+        return resource_ != nullptr || owns_inline();
+    }
+
+    constexpr bool owns_inline() const noexcept
+    {
+        if constexpr (is_inline) {
+            return this->data_ == inline_.data();
+        } else {
+            return false;
+        }
+    }
+
+    template <bool initialize>
+    constexpr T* allocate_storage(std::pmr::memory_resource* r) noexcept
+    {
+        if constexpr (is_inline) {
+            if constexpr (initialize) {
+                std::fill(inline_.data(), inline_.data() + absolute_volume, T{});
+            }
+            return inline_.data();
+        } else {
+            return impl::allocate<T, initialize>(absolute_volume, r);
+        }
+    }
+
+    /// @brief Copies shared elements before they are mutated.
+    constexpr void detach() noexcept
+    {
+        if (shared_ != nullptr) [[unlikely]] {
+            if (shared_->count.load(std::memory_order_acquire) > 1) {
+                auto* r = current_memory_resource();
+                T* d = impl::allocate<T, false>(absolute_volume, r);
+                std::copy(this->data_, this->data_ + absolute_volume, d);
+                release();
+                this->data_ = d;
+                resource_ = r;
+            } else {
+                impl::destroy_shared_block(shared_, resource_);
+                shared_ = nullptr;
+            }
+        }
+    }
+
+    constexpr void release() noexcept
+    {
+        if (shared_ != nullptr) {
+            if (shared_->count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                impl::destroy_shared_block(shared_, resource_);
+                impl::deallocate(this->data_, absolute_volume, resource_);
+            }
+            shared_ = nullptr;
+        } else if (resource_ != nullptr) {
+            impl::deallocate(this->data_, absolute_volume, resource_);
+        }
+    }
+
+    /// @brief Passes the owned elements to r, a matrix over the same storage.
+    template <typename R>
+    constexpr void transfer_ownership(R& r) noexcept
+    {
+        if constexpr (is_inline) {
+            static_assert(R::is_inline);
+            if (owns_inline()) {
+                r.data_ = r.inline_.data();
+                std::copy(this->data_, this->data_ + absolute_volume, r.data_);
+                return;
+            }
+        }
+        r.resource_ = resource_;
+        r.shared_ = shared_;
+        resource_ = nullptr;
+        shared_ = nullptr;
+    }
+
+    [[no_unique_address]] impl::inline_storage<T, absolute_volume> inline_;
+    std::pmr::memory_resource* resource_;
+    impl::shared_block* shared_;
+};
+
+/// @brief Matrix with a runtime size on axis 0: a batch of items of the continuous matrix type M.
+/// Items keep the compile time sizes and strides of M, so element access and the kernels within an item are those
+/// of M. Element-wise operations and dot run the outer loop over the items in parallel for big volumes.
+template <typename M>
+struct dynamic_matrix_impl
+{
+    static_assert(M::is_continuous);
+
+    /// @name Properties
+    /// @{
+    static constexpr inline int dimensions = M::dimensions + 1;
+
+    /// @brief Number of elements of an item.
+    static constexpr inline int64_t item_volume = M::volume;
+    /// @}
+
+    /// @name Utilities
+    /// @{
+    using value_type = typename M::value_type;
+
+    using item_type = M;
+
+    using item_view_type = typename M::view_type;
+
+    template <typename U>
+    using cast_matrix_type = dynamic_matrix_impl<typename M::template cast_matrix_type<U>>;
+
+    template <typename F>
+    using map_matrix_type = dynamic_matrix_impl<typename M::template map_matrix_type<F>>;
+
+    template <typename N>
+    using dot_product_type = dynamic_matrix_impl<typename M::template dot_product_type<N>>;
+    /// @}
+
+    /// @name Construction & Destruction
+    /// @{
+    /// @brief Owned matrix of size items allocated from the given memory resource, which should outlive it.
+    constexpr explicit dynamic_matrix_impl(int size, std::pmr::memory_resource* r = current_memory_resource()) noexcept
+        : data_{impl::allocate<value_type, true>(size * item_volume, r)}
+        , size_{size}
+        , resource_{r}
+    {
+        assert(size >= 0);
+    }
+
+    /// @brief Owned matrix of size items with uninitialized elements, for outputs overwritten as a whole.
+    constexpr dynamic_matrix_impl(uninitialized_t,
+                                  int size,
+                                  std::pmr::memory_resource* r = current_memory_resource()) noexcept
+        : data_{impl::allocate<value_type, false>(size * item_volume, r)}
+        , size_{size}
+        , resource_{r}
+    {
+        assert(size >= 0);
+    }
+
+    constexpr dynamic_matrix_impl(int size, const value_type& v) noexcept
+        : dynamic_matrix_impl{uninitialized, size}
+    {
+        std::fill(data_, data_ + volume(), v);
+    }
+
+    /// @brief Matrix over size items stored at d, which it doesn't own.
+    constexpr dynamic_matrix_impl(value_type* d, int size) noexcept
+        : data_{d}
+        , size_{size}
+        , resource_{nullptr}
+    {
+        assert(size >= 0);
+    }
+
+    constexpr explicit dynamic_matrix_impl(std::nullptr_t) noexcept
+        : data_{nullptr}
+        , size_{0}
+        , resource_{nullptr}
+    {
+    }
+
+    constexpr dynamic_matrix_impl(const dynamic_matrix_impl& m) noexcept
+        : data_{m.data_}
+        , size_{m.size_}
+        , resource_{nullptr}
+    {
+        if (m.resource_ != nullptr) {
+            resource_ = current_memory_resource();
+            data_ = impl::allocate<value_type, false>(volume(), resource_);
+            std::copy(m.data_, m.data_ + volume(), data_);
+        }
+    }
+
+    constexpr dynamic_matrix_impl(dynamic_matrix_impl&& m) noexcept
+        : data_{m.data_}
+        , size_{m.size_}
+        , resource_{m.resource_}
+    {
+        m.resource_ = nullptr;
+    }
+
+    ~dynamic_matrix_impl() noexcept
+    {
+        release();
+    }
+
+    /// @brief Copies the elements of m. Owned and null matrices take its size, reallocated when it differs. Matrices
+    /// over elements they don't own must have the size of m already, they are left unchanged otherwise.
+    constexpr dynamic_matrix_impl& operator=(const dynamic_matrix_impl& m) noexcept
+    {
+        if (this == (&m)) {
+            return *this;
+        }
+        if (size_ != m.size_) {
+            assert(resource_ != nullptr || data_ == nullptr);
+            if (resource_ == nullptr && data_ != nullptr) {
+                return *this;
+            }
+            auto* r = resource_ != nullptr ? resource_ : current_memory_resource();
+            value_type* d = impl::allocate<value_type, false>(m.volume(), r);
+            release();
+            data_ = d;
+            size_ = m.size_;
+            resource_ = r;
+        }
+        std::copy(m.data_, m.data_ + volume(), data_);
+        return *this;
+    }
+
+    constexpr dynamic_matrix_impl& operator=(dynamic_matrix_impl&& m) noexcept
+    {
+        release();
+        data_ = m.data_;
+        size_ = m.size_;
+        resource_ = m.resource_;
+        m.resource_ = nullptr;
+        return *this;
+    }
+
+    constexpr dynamic_matrix_impl copy() const noexcept
+    {
+        dynamic_matrix_impl r{uninitialized, size_};
+        std::copy(data_, data_ + volume(), r.data_);
+        return r;
+    }
+
+    template <typename U>
+    constexpr cast_matrix_type<U> cast() const noexcept
+    {
+        return map([](const value_type& v) { return static_cast<U>(v); });
+    }
+    /// @}
+
+    /// @name Element Access
+    /// @{
+    /// @brief Number of items, the size of axis 0.
+    constexpr int size() const noexcept
+    {
+        return size_;
+    }
+
+    constexpr int64_t volume() const noexcept
+    {
+        return size_ * item_volume;
+    }
+
+    constexpr item_view_type operator[](int index) noexcept
+    {
+        assert(index < size_ && index >= 0);
+        return item_view_type{data_ + index * item_volume, data_ + (index + 1) * item_volume};
+    }
+
+    constexpr const item_view_type operator[](int index) const noexcept
+    {
+        assert(index < size_ && index >= 0);
+        return item_view_type{data_ + index * item_volume, data_ + (index + 1) * item_volume};
+    }
+
+    template <typename ... I>
+    constexpr value_type& at(int index, I ... indices) noexcept
+    {
+        return operator[](index).at(indices ...);
+    }
+
+    template <typename ... I>
+    constexpr const value_type& at(int index, I ... indices) const noexcept
+    {
+        return operator[](index).at(indices ...);
+    }
+
+    value_type* data() noexcept
+    {
+        return data_;
+    }
+
+    const value_type* data() const noexcept
+    {
+        return data_;
+    }
+
+    value_type* begin() noexcept
+    {
+        return data_;
+    }
+
+    value_type* end() noexcept
+    {
+        return data_ + volume();
+    }
+
+    const value_type* begin() const noexcept
+    {
+        return data_;
+    }
+
+    const value_type* end() const noexcept
+    {
+        return data_ + volume();
+    }
+
+#if defined(__cpp_lib_mdspan)
+    /// @brief Row-major std::mdspan over the elements with a dynamic extent on axis 0, without copying.
+    constexpr auto to_mdspan() noexcept
+    {
+        return make_mdspan(data_, std::make_index_sequence<M::dimensions>{});
+    }
+
+    constexpr auto to_mdspan() const noexcept
+    {
+        return make_mdspan(static_cast<const value_type*>(data_), std::make_index_sequence<M::dimensions>{});
+    }
+#endif
+    /// @}
+
+    /// @name Operations
+    /// Operands are matrices of the same type, matrices broadcast to every item or scalars. Results of operands with
+    /// another number of items are null, in place operations leave the matrix unchanged.
+    /// @{
+    template <typename N>
+    constexpr dynamic_matrix_impl& operator+=(const N& m) noexcept
+    {
+        update([](value_type& a, const auto& b) { a += b; }, m);
+        return *this;
+    }
+
+    template <typename N>
+    constexpr dynamic_matrix_impl& operator-=(const N& m) noexcept
+    {
+        update([](value_type& a, const auto& b) { a -= b; }, m);
+        return *this;
+    }
+
+    template <typename N>
+    constexpr dynamic_matrix_impl& operator*=(const N& m) noexcept
+    {
+        update([](value_type& a, const auto& b) { a *= b; }, m);
+        return *this;
+    }
+
+    template <typename N>
+    constexpr dynamic_matrix_impl& operator/=(const N& m) noexcept
+    {
+        update([](value_type& a, const auto& b) { a /= b; }, m);
+        return *this;
+    }
+
+    template <typename N>
+    constexpr dynamic_matrix_impl operator+(const N& m) const noexcept
+    {
+        if (!matches(m)) {
+            return dynamic_matrix_impl{nullptr};
+        }
+        auto r = copy();
+        r += m;
+        return r;
+    }
+
+    template <typename N>
+    constexpr dynamic_matrix_impl operator-(const N& m) const noexcept
+    {
+        if (!matches(m)) {
+            return dynamic_matrix_impl{nullptr};
+        }
+        auto r = copy();
+        r -= m;
+        return r;
+    }
+
+    template <typename N>
+    constexpr dynamic_matrix_impl operator*(const N& m) const noexcept
+    {
+        if (!matches(m)) {
+            return dynamic_matrix_impl{nullptr};
+        }
+        auto r = copy();
+        r *= m;
+        return r;
+    }
+
+    template <typename N>
+    constexpr dynamic_matrix_impl operator/(const N& m) const noexcept
+    {
+        if (!matches(m)) {
+            return dynamic_matrix_impl{nullptr};
+        }
+        auto r = copy();
+        r /= m;
+        return r;
+    }
+
+    /// Big matrices are processed in parallel, so f must be safe to call concurrently.
+    template <typename F>
+    constexpr map_matrix_type<F> map(const F& f) const noexcept
+    {
+        map_matrix_type<F> r{uninitialized, size_};
+        for_each_item([&f](auto& o, const value_type& v) { o = f(v); }, r, *this);
+        return r;
+    }
+
+    template <typename F>
+    constexpr dynamic_matrix_impl& map_inplace(const F& f) noexcept
+    {
+        for_each_item([&f](value_type& v) { v = f(v); }, *this);
+        return *this;
+    }
+
+    template <typename N, typename F>
+    constexpr auto zip_with(const N& m, const F& f) const noexcept
+    {
+        using R = std::remove_cvref_t<std::invoke_result_t<const F&, const value_type&, const typename N::value_type&>>;
+        if (!matches(m)) {
+            return cast_matrix_type<R>{nullptr};
+        }
+        cast_matrix_type<R> r{uninitialized, size_};
+        for_each_item([&f](auto& o, const value_type& a, const auto& b) { o = f(a, b); }, r, *this, m);
+        return r;
+    }
+
+    template <typename N, typename F>
+    constexpr dynamic_matrix_impl& zip_with_inplace(const N& m, const F& f) noexcept
+    {
+        assert(matches(m));
+        if (!matches(m)) {
+            return *this;
+        }
+        for_each_item([&f](value_type& a, const auto& b) { a = f(a, b); }, *this, m);
+        return *this;
+    }
+
+    /// @brief Dot product of every item with the matrix m.
+    template <typename N>
+    constexpr dot_product_type<N> dot(const N& m) const noexcept
+    {
+        using R = typename M::template dot_product_type<N>;
+        constexpr int64_t item_complexity = R::volume * std::get<M::dimensions - 1>(M::sizes);
+        dot_product_type<N> r{uninitialized, size_};
+        if (size_ >= threads && size_ * item_complexity > crit_compl) {
+            parallel_for(size_, [&](int64_t start, int64_t end) {
+                for (auto i = start; i < end; ++i) {
+                    auto rr = r[i];
+                    dot_into<false>(operator[](i), m, rr);
+                }
+            });
+        } else {
+            for (auto i = 0; i < size_; ++i) {
+                auto rr = r[i];
+                dot_into<(item_complexity > crit_compl)>(operator[](i), m, rr);
+            }
+        }
+        return r;
+    }
+    /// @}
+
+    /// @name Comparison
+    /// @{
+    constexpr bool operator==(const dynamic_matrix_impl& m) const noexcept
+    {
+        return size_ == m.size_ && std::equal(data_, data_ + volume(), m.data_);
+    }
+
+    constexpr bool operator==(std::nullptr_t) const noexcept
+    {
+        return data_ == nullptr;
+    }
+
+    template <typename N>
+    constexpr bool operator!=(const N& m) const noexcept
+    {
+        return !((*this) == m);
+    }
+    /// @}
+
+    template <typename N>
+    friend struct dynamic_matrix_impl;
+
+private:
+    /// @brief Item i of m, or m itself when it is broadcast to every item.
+    template <typename N>
+    static constexpr decltype(auto) item(N& m, int i) noexcept
+    {
+        if constexpr (is_dynamic_matrix<std::remove_cv_t<N>>) {
+            return m[i];
+        } else {
+            return typename std::remove_cv_t<N>::const_view_type{m};
+        }
+    }
+
+    template <typename N>
+    using item_view = std::remove_cvref_t<decltype(item(std::declval<N&>(), 0))>;
+
+    /// @brief Whether m has as many items, or is broadcast to every item.
+    template <typename N>
+    constexpr bool matches(const N& m) const noexcept
+    {
+        if constexpr (is_dynamic_matrix<N>) {
+            return m.size() == size_;
+        } else {
+            return true;
+        }
+    }
+
+    /// @brief Applies f element-wise over the items of the matrices, the items in parallel when there are enough
+    /// of them, the elements of an item in parallel otherwise.
+    template <typename F, typename ... Ns>
+    constexpr void for_each_item(const F& f, Ns& ... ms) const noexcept
+    {
+        using C = element_wise_calculator<false, item_view<Ns> ...>;
+        if (size_ >= threads && volume() > crit_compl) {
+            parallel_for(size_, [&f, &ms ...](int64_t start, int64_t end) {
+                for (auto i = static_cast<int>(start); i < end; ++i) {
+                    C::calculate(f, item(ms, i) ...);
+                }
+            });
+        } else {
+            for (auto i = 0; i < size_; ++i) {
+                element_wise_calculator<(C::volume > crit_compl), item_view<Ns> ...>::calculate(f, item(ms, i) ...);
+            }
+        }
+    }
+
+    template <typename F, typename N>
+    constexpr void update(const F& f, const N& m) noexcept
+    {
+        if constexpr (is_matrix<N> || is_dynamic_matrix<N>) {
+            assert(matches(m));
+            if (!matches(m)) {
+                return;
+            }
+            for_each_item(f, *this, m);
+        } else {
+            for_each_item([&f, &m](value_type& a) { f(a, m); }, *this);
+        }
+    }
+
+#if defined(__cpp_lib_mdspan)
+    template <typename U, std::size_t ... i>
+    constexpr auto make_mdspan(U* d, std::index_sequence<i ...>) const noexcept
+    {
+        using E = std::extents<std::ptrdiff_t, std::dynamic_extent, static_cast<std::size_t>(std::get<i>(M::sizes)) ...>;
+        return std::mdspan<U, E>{d, size_};
+    }
+#endif
+
+    constexpr void release() noexcept
+    {
+        if (resource_ != nullptr) {
+            impl::deallocate(data_, volume(), resource_);
+        }
+    }
+
+    value_type* data_;
+    int size_;
+    std::pmr::memory_resource* resource_;
+};
 
 }
 
 template <typename T, int ... sizes>
-using matrixd = impl::continuous_matrixd<T, sizes ...>;
+using matrixd = typename impl::matrixd_type<T, sizes ...>::type;
+
+#if defined(__cpp_lib_mdspan)
+/// @brief Matrix view over the elements of a row-major mdspan with static extents, without copying.
+template <typename T, typename I, std::size_t ... s>
+    requires ((s != std::dynamic_extent) && ...)
+constexpr auto from_mdspan(const std::mdspan<T, std::extents<I, s ...>, std::layout_right>& m) noexcept
+{
+    using R = typename matrixd<T, static_cast<int>(s) ...>::view_type;
+    return R{std::span<T, R::absolute_volume>{m.data_handle(), R::absolute_volume}};
+}
+
+/// @brief View of type M over the elements of a strided mdspan, typically one returned by to_mdspan of an M,
+/// without copying. The extents and strides of the mdspan must be those of M.
+template <typename M, typename T, typename E>
+constexpr typename M::view_type from_mdspan(const std::mdspan<T, E, std::layout_stride>& m) noexcept
+{
+    using S = impl::mdspan_type_impl<typename M::view_type, T>;
+    static_assert(std::is_same<T, typename M::value_type>::value);
+    static_assert(E::rank() == M::dimensions);
+    assert(S::matches(m));
+    return typename M::view_type{std::span<T, M::absolute_volume>{m.data_handle() - S::origin, M::absolute_volume}};
+}
+#endif
+
+/// @brief Valid 2D convolution (cross-correlation) of (C, H, W) or (N, C, H, W) input with (F, C, KH, KW) kernels.
+template <int stride_h = 1, int stride_w = 1, typename I, typename K>
+constexpr auto conv2d(const I& input, const K& kernels) noexcept
+{
+    static_assert(I::dimensions == 3 || I::dimensions == 4);
+    static_assert(K::dimensions == 4);
+    if constexpr (!I::is_continuous) {
+        return conv2d<stride_h, stride_w>(input.copy(), kernels);
+    } else if constexpr (!K::is_continuous) {
+        return conv2d<stride_h, stride_w>(input, kernels.copy());
+    } else {
+        using T = typename I::value_type;
+        static_assert(std::is_same<T, typename K::value_type>::value);
+        constexpr int d = I::dimensions - 3;
+        constexpr int batch = d == 1 ? std::get<0>(I::sizes) : 1;
+        constexpr int f = std::get<0>(K::sizes);
+        constexpr int c = std::get<1>(K::sizes);
+        static_assert(c == std::get<d>(I::sizes));
+        using calculator = impl::convolution_calculator<T,
+                                                        c,
+                                                        std::get<d + 1>(I::sizes),
+                                                        std::get<d + 2>(I::sizes),
+                                                        f,
+                                                        std::get<2>(K::sizes),
+                                                        std::get<3>(K::sizes),
+                                                        stride_h,
+                                                        stride_w,
+                                                        (I::volume / c * K::volume > crit_compl)>;
+        using R = std::conditional_t<d == 1,
+                                     matrixd<T, batch, f, calculator::OH, calculator::OW>,
+                                     matrixd<T, f, calculator::OH, calculator::OW>>;
+        R r{uninitialized};
+        calculator::calculate(input.data(), kernels.data(), r.data(), batch);
+        return r;
+    }
+}
+
+/// @brief Valid 1D convolution (cross-correlation) of (C, L) or (N, C, L) input with (F, C, K) kernels.
+template <int stride = 1, typename I, typename K>
+constexpr auto conv1d(const I& input, const K& kernels) noexcept
+{
+    static_assert(I::dimensions == 2 || I::dimensions == 3);
+    static_assert(K::dimensions == 3);
+    if constexpr (!I::is_continuous) {
+        return conv1d<stride>(input.copy(), kernels);
+    } else if constexpr (!K::is_continuous) {
+        return conv1d<stride>(input, kernels.copy());
+    } else {
+        constexpr int f = std::get<0>(K::sizes);
+        constexpr int c = std::get<1>(K::sizes);
+        constexpr int k = std::get<2>(K::sizes);
+        constexpr int l = std::get<I::dimensions - 1>(I::sizes);
+        constexpr int o = (l - k) / stride + 1;
+        const auto kk = kernels.template reshape<f, c, 1, k>();
+        if constexpr (I::dimensions == 3) {
+            constexpr int n = std::get<0>(I::sizes);
+            return conv2d<1, stride>(input.template reshape<n, c, 1, l>(), kk).template reshape<n, f, o>();
+        } else {
+            return conv2d<1, stride>(input.template reshape<c, 1, l>(), kk).template reshape<f, o>();
+        }
+    }
+}
+
+/// @brief LU factorization with partial pivoting of (N, n, n) or (n, n) matrices.
+/// Returns the packed factors, unit lower L below the diagonal and U on and above it, and the pivots: row k was
+/// swapped with row pivots[k] at step k.
+template <typename A>
+constexpr auto lu(const A& a) noexcept
+{
+    using shape = impl::system_shape<A>;
+    using T = typename A::value_type;
+    using P = std::conditional_t<shape::d == 1, matrixd<int, shape::count, shape::n>, matrixd<int, shape::n>>;
+    std::pair<typename A::continuous_matrix_type, P> r{a.copy(), P{uninitialized}};
+    impl::solver_calculator<T, shape::n, 0, (A::volume * shape::n > crit_compl)>::lu(r.first.data(),
+                                                                                       r.second.data(),
+                                                                                       shape::count);
+    return r;
+}
+
+/// @brief Cholesky factorization of symmetric positive definite (N, n, n) or (n, n) matrices, lower factor.
+template <typename A>
+constexpr typename A::continuous_matrix_type cholesky(const A& a) noexcept
+{
+    using shape = impl::system_shape<A>;
+    auto r = a.copy();
+    impl::solver_calculator<typename A::value_type, shape::n, 0, (A::volume * shape::n > crit_compl)>::cholesky(
+        r.data(), shape::count);
+    return r;
+}
+
+/// @brief Solution of triangular systems a x = b, for b of (N, n), (N, n, m), (n) or (n, m).
+template <bool lower = true, bool unit_diagonal = false, typename A, typename B>
+constexpr typename B::continuous_matrix_type trsm(const A& a, const B& b) noexcept
+{
+    using shape = impl::system_shape<A, B>;
+    if constexpr (!A::is_continuous) {
+        return trsm<lower, unit_diagonal>(a.copy(), b);
+    } else {
+        auto x = b.copy();
+        impl::solver_calculator<typename A::value_type,
+                                shape::n,
+                                shape::m,
+                                (B::volume * shape::n > crit_compl)>::template trsm<lower, unit_diagonal>(a.data(),
+                                                                                                         x.data(),
+                                                                                                         shape::count);
+        return x;
+    }
+}
+
+/// @brief Solution of general systems a x = b through LU factorization with partial pivoting.
+template <typename A, typename B>
+constexpr typename B::continuous_matrix_type solve(const A& a, const B& b) noexcept
+{
+    using shape = impl::system_shape<A, B>;
+    auto f = a.copy();
+    auto x = b.copy();
+    impl::solver_calculator<typename A::value_type,
+                            shape::n,
+                            shape::m,
+                            (A::volume * shape::n > crit_compl)>::solve(f.data(), x.data(), shape::count);
+    return x;
+}
+
+/// @brief Uniform distribution over [a, b) for floating point and [a, b] for integer types.
+template <typename T>
+struct uniform_distribution
+{
+    T a = T{0};
+    T b = T{1};
+
+    constexpr T operator()(const std::array<uint32_t, 4>& r) const noexcept
+    {
+        if constexpr (std::is_integral<T>::value) {
+            const auto range = static_cast<uint64_t>(static_cast<int64_t>(b) - static_cast<int64_t>(a)) + 1;
+            return static_cast<T>(static_cast<int64_t>(a) + static_cast<int64_t>((range * r[0]) >> 32));
+        } else if constexpr (sizeof(T) > sizeof(float)) {
+            const auto u = static_cast<T>(((uint64_t{r[0]} << 32 | r[1]) >> 11) * 0x1.0p-53);
+            return a + (b - a) * u;
+        } else {
+            const auto u = static_cast<T>((r[0] >> 8) * 0x1.0p-24f);
+            return a + (b - a) * u;
+        }
+    }
+};
+
+/// @brief Normal distribution, by the Box-Muller transform.
+template <typename T>
+struct normal_distribution
+{
+    T mean = T{0};
+    T stddev = T{1};
+
+    T operator()(const std::array<uint32_t, 4>& r) const noexcept
+    {
+        const double u1 = (r[0] + 1.0) * 0x1.0p-32;
+        const double u2 = r[1] * 0x1.0p-32;
+        const double z = std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+        return static_cast<T>(mean + stddev * z);
+    }
+};
+
+/// @brief Bernoulli distribution, 1 with probability p.
+struct bernoulli_distribution
+{
+    double p = 0.5;
+
+    constexpr int operator()(const std::array<uint32_t, 4>& r) const noexcept
+    {
+        return r[0] < p * 0x1.0p32 ? 1 : 0;
+    }
+};
+
+/// @brief Element-wise select: a where c is true, b otherwise. Either of a and b can be a scalar.
+template <typename C, typename A, typename B>
+constexpr auto where(const C& c, const A& a, const B& b) noexcept
+{
+    using R = std::common_type_t<typename impl::element_type<A>::type, typename impl::element_type<B>::type>;
+    constexpr bool ma = impl::is_matrix<A>;
+    constexpr bool mb = impl::is_matrix<B>;
+    if constexpr (ma && mb) {
+        typename impl::broadcast_matrix_type<R, C, A, B>::type r{uninitialized};
+        impl::element_wise([](R& o, const auto& k, const auto& x, const auto& y) {
+                o = k ? static_cast<R>(x) : static_cast<R>(y);
+            }, r, c, a, b);
+        return r;
+    } else if constexpr (ma) {
+        typename impl::broadcast_matrix_type<R, C, A>::type r{uninitialized};
+        impl::element_wise([y = static_cast<R>(b)](R& o, const auto& k, const auto& x) {
+                o = k ? static_cast<R>(x) : y;
+            }, r, c, a);
+        return r;
+    } else if constexpr (mb) {
+        typename impl::broadcast_matrix_type<R, C, B>::type r{uninitialized};
+        impl::element_wise([x = static_cast<R>(a)](R& o, const auto& k, const auto& y) {
+                o = k ? x : static_cast<R>(y);
+            }, r, c, b);
+        return r;
+    } else {
+        typename impl::broadcast_matrix_type<R, C>::type r{uninitialized};
+        impl::element_wise([x = static_cast<R>(a), y = static_cast<R>(b)](R& o, const auto& k) {
+                o = k ? x : y;
+            }, r, c);
+        return r;
+    }
+}
+
+/// @brief Writes the matrices joined along the axis into dst, whose sizes must be theirs with the sizes along the
+/// axis summed. Continuous matrices of the element type of dst are copied as contiguous runs, one per input and
+/// index of the leading axes, in parallel for big volumes; anything else is assigned through crops of dst.
+template <int axis, typename E, typename ... M>
+constexpr void concat_into(E&& dst, const M& ... ms) noexcept
+{
+    using D = std::remove_cvref_t<E>;
+    using T = typename D::value_type;
+    using R = typename impl::concat_matrix_type<axis, T, M ...>::type;
+    static_assert(D::sizes == R::sizes);
+    // data() copies the elements of a shared dst before either path writes them.
+    T* d = dst.data();
+    if constexpr (D::is_continuous && D::volume > 0 &&
+                  ((M::is_continuous && std::is_same<T, typename M::value_type>::value) && ...)) {
+        constexpr auto n = sizeof...(M);
+        constexpr int64_t row = int64_t{std::get<axis>(D::sizes)} * std::get<axis>(D::absolute_offsets);
+        constexpr int64_t outer = D::volume / row;
+        constexpr std::array<int64_t, n> lengths{M::volume / outer ...};
+        const std::array<const T*, n> sources{ms.data() ...};
+        std::array<int64_t, n> offsets{};
+        for (std::size_t i = 1; i < n; ++i) {
+            offsets[i] = offsets[i - 1] + lengths[i - 1];
+        }
+        const auto copy = [&](int64_t start, int64_t end) {
+            for (auto t = start; t < end; ++t) {
+                const auto i = t % n;
+                const auto r = t / n;
+                std::copy_n(sources[i] + r * lengths[i], lengths[i], d + r * row + offsets[i]);
+            }
+        };
+        if constexpr (D::volume > crit_compl) {
+            impl::parallel_for(outer * n, copy);
+        } else {
+            copy(0, outer * n);
+        }
+    } else {
+        typename D::view_type v = dst;
+        impl::concat_assign<axis, 0>(v, ms ...);
+    }
+}
+
+/// @brief Continuous matrix of the matrices joined along the axis, allocated once.
+template <int axis, typename M, typename ... N>
+constexpr auto concat(const M& m, const N& ... ns) noexcept
+{
+    using T = std::common_type_t<typename M::value_type, typename N::value_type ...>;
+    typename impl::concat_matrix_type<axis, T, M, N ...>::type r{uninitialized};
+    concat_into<axis>(r, m, ns ...);
+    return r;
+}
+
+/// @brief Continuous matrix of the matrices of the same sizes stacked along a new axis inserted before the given one.
+template <int axis, typename M, typename ... N>
+constexpr auto stack(const M& m, const N& ... ns) noexcept
+{
+    static_assert(((M::sizes == N::sizes) && ...));
+    return concat<axis>(impl::inserted_axis_view<axis>(m, std::make_index_sequence<M::dimensions + 1>{}),
+                        impl::inserted_axis_view<axis>(ns, std::make_index_sequence<M::dimensions + 1>{}) ...);
+}
 
 }
@@ -2,7 +2,10 @@
 
 #include <cmath>
 #include <chrono>
+#include <execution>
 #include <iostream>
+#include <filesystem>
+#include <numeric>
 #include <random>
 
 #ifdef __APPLE__
@@ -987,3 +990,1178 @@ TEST(matrixd, different_size_multiplication_test) {
         ASSERT_TRUE(std::abs(p[i] - 0.1) < 0.0001);
     }
 }
+
+TEST(matrixd, cast_test) {
+    static_assert(std::is_same<khustup::matrixd<float, 2, 3>::cast_matrix_type<int>,
+                               khustup::matrixd<int, 2, 3>>::value);
+    {
+        khustup::matrixd<float, 2, 3, 4> m{2.75f};
+        m[1] = -300.5f;
+        auto n = m.cast<int>();
+        static_assert(std::is_same<decltype(n), khustup::matrixd<int, 2, 3, 4>>::value);
+        for (auto j = 0; j < 3; ++j) {
+            for (auto k = 0; k < 4; ++k) {
+                ASSERT_EQ(n[0][j][k], 2);
+                ASSERT_EQ(n[1][j][k], -300);
+            }
+        }
+        auto s = m.cast<int8_t, true>();
+        for (auto j = 0; j < 3; ++j) {
+            for (auto k = 0; k < 4; ++k) {
+                ASSERT_EQ(s[0][j][k], 2);
+                ASSERT_EQ(s[1][j][k], -128);
+            }
+        }
+    }
+    {
+        khustup::matrixd<int, 4> m{70000};
+        m[1] = -70000;
+        m[2] = 17;
+        auto s = m.cast<int16_t, true>();
+        ASSERT_EQ(s[0], 32767);
+        ASSERT_EQ(s[1], -32768);
+        ASSERT_EQ(s[2], 17);
+        auto d = m.cast<double>();
+        ASSERT_EQ(d[0], 70000.0);
+        ASSERT_EQ(d[1], -70000.0);
+    }
+    {
+        khustup::matrixd<int, 4, 6> m{};
+        for (auto i = 0; i < 4; ++i) {
+            for (auto j = 0; j < 6; ++j) {
+                m[i][j] = i * 6 + j;
+            }
+        }
+        khustup::matrixd<double, 6, 8> d{-1.0};
+        m.crop<1, 2, 2, 3>().cast_into(d.swap_axes<0, 1>().crop<3, 2, 1, 3>());
+        for (auto i = 0; i < 2; ++i) {
+            for (auto j = 0; j < 3; ++j) {
+                ASSERT_EQ(d[1 + j][3 + i], (1 + i) * 6 + 2 + j);
+            }
+        }
+        ASSERT_EQ(d[0][0], -1.0);
+        ASSERT_EQ(d[4][3], -1.0);
+    }
+    {
+        khustup::matrixd<int, 2, 3> a{3};
+        khustup::matrixd<float, 1, 3> b{0.5f};
+        auto c = a + b;
+        static_assert(std::is_same<decltype(c), khustup::matrixd<float, 2, 3>>::value);
+        auto d = b * a;
+        static_assert(std::is_same<decltype(d), khustup::matrixd<float, 2, 3>>::value);
+        for (auto i = 0; i < 2; ++i) {
+            for (auto j = 0; j < 3; ++j) {
+                ASSERT_EQ(c[i][j], 3.5f);
+                ASSERT_EQ(d[i][j], 1.5f);
+            }
+        }
+        khustup::matrixd<int, 5> e{7};
+        khustup::matrixd<double, 5> f{0.25};
+        auto g = e / f;
+        for (auto i = 0; i < 5; ++i) {
+            ASSERT_EQ(g[i], 28.0);
+        }
+    }
+}
+
+TEST(matrixd, map_zip_test) {
+    {
+        khustup::matrixd<float, 3, 4> m{};
+        m.for_each_indexed([](float& v, int i, int j) {
+                v = static_cast<float>(i * 4 + j) - 5.0f;
+            });
+        auto r = m.map([](float v) { return v > 0.0f ? v : 0.0f; });
+        auto b = m.map([](float v) { return v > 0.0f; });
+        static_assert(std::is_same<decltype(b), khustup::matrixd<bool, 3, 4>>::value);
+        for (auto i = 0; i < 3; ++i) {
+            for (auto j = 0; j < 4; ++j) {
+                ASSERT_EQ(r[i][j], std::max(i * 4 + j - 5.0f, 0.0f));
+                ASSERT_EQ(b[i][j], i * 4 + j > 5);
+            }
+        }
+        m.crop<1, 2, 1, 2>().map_inplace([](float v) { return v * 10.0f; });
+        ASSERT_EQ(m[1][1], 0.0f);
+        ASSERT_EQ(m[1][2], 10.0f);
+        ASSERT_EQ(m[2][2], 50.0f);
+        ASSERT_EQ(m[2][3], 6.0f);
+    }
+    {
+        khustup::matrixd<int, 4, 1> a{};
+        khustup::matrixd<int, 1, 5> b{};
+        a.for_each_indexed([](int& v, int i, int) { v = i; });
+        b.for_each_indexed([](int& v, int, int j) { v = 10 * j; });
+        auto c = a.zip_with(b, [](int x, int y) { return x + y + 0.5; });
+        static_assert(std::is_same<decltype(c), khustup::matrixd<double, 4, 5>>::value);
+        c.for_each_indexed([](double v, int i, int j) {
+                ASSERT_EQ(v, i + 10 * j + 0.5);
+            });
+        khustup::matrixd<int, 4, 5> d{1};
+        d.zip_with_inplace(b, [](int x, int y) { return x - y; });
+        d.for_each_indexed([](int v, int, int j) {
+                ASSERT_EQ(v, 1 - 10 * j);
+            });
+    }
+    {
+        khustup::matrixd<float, 300, 4000> m{};
+        m.for_each_indexed([](float& v, int i, int j) { v = static_cast<float>(i - j); });
+        auto r = m.swap_axes<0, 1>().map([](float v) { return std::abs(v); });
+        static_assert(std::is_same<decltype(r), khustup::matrixd<float, 4000, 300>>::value);
+        auto s = m.zip_with(m, [](float x, float y) { return x * y; });
+        for (auto i = 0; i < 300; i += 7) {
+            for (auto j = 0; j < 4000; j += 13) {
+                ASSERT_EQ(r[j][i], std::abs(static_cast<float>(i - j)));
+                ASSERT_EQ(s[i][j], static_cast<float>((i - j) * (i - j)));
+            }
+        }
+    }
+}
+
+TEST(matrixd, masked_operations_test) {
+    khustup::matrixd<float, 3, 4> m{};
+    m.for_each_indexed([](float& v, int i, int j) { v = static_cast<float>(i * 4 + j) - 5.0f; });
+    khustup::matrixd<float, 1, 4> t{};
+    t.for_each_indexed([](float& v, int, int j) { v = static_cast<float>(j); });
+    {
+        auto mask = m > 0.0f;
+        static_assert(std::is_same<decltype(mask), khustup::matrixd<bool, 3, 4>>::value);
+        auto mask2 = m <= t;
+        static_assert(std::is_same<decltype(mask2), khustup::matrixd<bool, 3, 4>>::value);
+        auto mask3 = m.equal(t);
+        m.for_each_indexed([&](float v, int i, int j) {
+                ASSERT_EQ(mask[i][j], v > 0.0f);
+                ASSERT_EQ(mask2[i][j], v <= j);
+                ASSERT_EQ(mask3[i][j], v == j);
+            });
+    }
+    {
+        auto r = khustup::where(m > 0.0f, m, 0.0f);
+        auto s = khustup::where(m < t, t, m);
+        auto u = khustup::where(m >= 0.0f, 1, -1);
+        static_assert(std::is_same<decltype(u), khustup::matrixd<int, 3, 4>>::value);
+        m.for_each_indexed([&](float v, int i, int j) {
+                ASSERT_EQ(r[i][j], v > 0.0f ? v : 0.0f);
+                ASSERT_EQ(s[i][j], std::max(v, static_cast<float>(j)));
+                ASSERT_EQ(u[i][j], v >= 0.0f ? 1 : -1);
+            });
+    }
+    {
+        auto c = m.clamp(-2.0f, 3.0f);
+        auto lo = m.min(t);
+        auto hi = m.max(1.5f);
+        m.for_each_indexed([&](float v, int i, int j) {
+                ASSERT_EQ(c[i][j], std::clamp(v, -2.0f, 3.0f));
+                ASSERT_EQ(lo[i][j], std::min(v, static_cast<float>(j)));
+                ASSERT_EQ(hi[i][j], std::max(v, 1.5f));
+            });
+    }
+}
+
+TEST(matrixd, scan_test) {
+    {
+        khustup::matrixd<int, 37> m{};
+        m.for_each_indexed([](int& v, int i) { v = i + 1; });
+        auto r = m.cumsum<0>();
+        auto e = m.scan<0, std::plus<>, false>();
+        for (auto i = 0; i < 37; ++i) {
+            ASSERT_EQ(r[i], (i + 1) * (i + 2) / 2);
+            ASSERT_EQ(e[i], i * (i + 1) / 2);
+        }
+    }
+    {
+        khustup::matrixd<int, 3, 5, 21> m{};
+        m.for_each_indexed([](int& v, int i, int j, int k) { v = (i * 7 + j * 3 + k) % 5 - 2; });
+        auto r0 = m.cumsum<0>();
+        auto r1 = m.cumsum<1>();
+        auto r2 = m.cumsum<2>();
+        auto p1 = m.swap_axes<0, 2>().crop<1, 20, 0, 5, 1, 2>().cumprod<1>();
+        m.for_each_indexed([&](int, int i, int j, int k) {
+                int s0 = 0, s1 = 0, s2 = 0;
+                for (auto x = 0; x <= i; ++x) {
+                    s0 += m[x][j][k];
+                }
+                for (auto x = 0; x <= j; ++x) {
+                    s1 += m[i][x][k];
+                }
+                for (auto x = 0; x <= k; ++x) {
+                    s2 += m[i][j][x];
+                }
+                ASSERT_EQ(r0[i][j][k], s0);
+                ASSERT_EQ(r1[i][j][k], s1);
+                ASSERT_EQ(r2[i][j][k], s2);
+            });
+        p1.for_each_indexed([&](int v, int k, int j, int i) {
+                int p = 1;
+                for (auto x = 0; x <= j; ++x) {
+                    p *= m[1 + i][x][1 + k];
+                }
+                ASSERT_EQ(v, p);
+            });
+    }
+    {
+        khustup::matrixd<int64_t, 2, 1000000> m{int64_t{1}};
+        auto r = m.cumsum<1>();
+        auto e = m.scan<1, std::plus<>, false>();
+        for (auto i = 0; i < 2; ++i) {
+            for (auto j = 0; j < 1000000; j += 997) {
+                ASSERT_EQ(r[i][j], j + 1);
+                ASSERT_EQ(e[i][j], j);
+            }
+            ASSERT_EQ(r[i][999999], 1000000);
+        }
+        khustup::matrixd<int, 600000, 3> n{2};
+        auto s = n.cumsum<0>();
+        for (auto j = 0; j < 600000; j += 1013) {
+            ASSERT_EQ(s[j][2], 2 * (j + 1));
+        }
+        ASSERT_EQ(s[599999][0], 1200000);
+    }
+}
+
+TEST(matrixd, topk_test) {
+    {
+        khustup::matrixd<float, 3, 50000> m{};
+        std::mt19937 generator{17};
+        std::uniform_real_distribution<float> distribution{0.0f, 1.0f};
+        std::generate(m.data(), m.data() + m.volume, [&]() { return distribution(generator); });
+        auto [v, x] = m.topk<1, 100>();
+        static_assert(std::is_same<decltype(v), khustup::matrixd<float, 3, 100>>::value);
+        static_assert(std::is_same<decltype(x), khustup::matrixd<int, 3, 100>>::value);
+        auto a = m.argmax<1>();
+        auto b = m.argmin<1>();
+        for (auto i = 0; i < 3; ++i) {
+            std::vector<int> order(50000);
+            std::iota(order.begin(), order.end(), 0);
+            std::partial_sort(order.begin(), order.begin() + 100, order.end(), [&](int p, int q) {
+                    return m[i][p] > m[i][q] || (m[i][p] == m[i][q] && p < q);
+                });
+            for (auto r = 0; r < 100; ++r) {
+                ASSERT_EQ(x[i][r], order[r]);
+                ASSERT_EQ(v[i][r], m[i][order[r]]);
+            }
+            ASSERT_EQ(a[i][0], order[0]);
+            ASSERT_EQ(b[i][0], std::min_element(m.data() + i * 50000, m.data() + (i + 1) * 50000) - (m.data() + i * 50000));
+        }
+    }
+    {
+        khustup::matrixd<int, 4, 6, 5> m{};
+        m.for_each_indexed([](int& v, int i, int j, int k) { v = ((i + 1) * (j + 3) * (k + 7)) % 11; });
+        auto [v, x] = m.topk<1, 3>();
+        static_assert(std::is_same<decltype(v), khustup::matrixd<int, 4, 3, 5>>::value);
+        auto [w, y] = m.swap_axes<1, 2>().topk<2, 3>();
+        for (auto i = 0; i < 4; ++i) {
+            for (auto k = 0; k < 5; ++k) {
+                std::vector<std::pair<int, int>> c;
+                for (auto j = 0; j < 6; ++j) {
+                    c.emplace_back(-m[i][j][k], j);
+                }
+                std::sort(c.begin(), c.end());
+                for (auto r = 0; r < 3; ++r) {
+                    ASSERT_EQ(v[i][r][k], -c[r].first);
+                    ASSERT_EQ(x[i][r][k], c[r].second);
+                    ASSERT_EQ(w[i][k][r], -c[r].first);
+                    ASSERT_EQ(y[i][k][r], c[r].second);
+                }
+            }
+        }
+    }
+}
+
+TEST(matrixd, fill_random_test) {
+    {
+        khustup::matrixd<float, 1000, 1500> m{};
+        m.fill_random<khustup::uniform_distribution<float>>(42);
+        khustup::matrixd<float, 20, 1500> n{};
+        n.fill_random<khustup::uniform_distribution<float>>(42);
+        ASSERT_EQ(n, (m.crop<0, 20, 0, 1500>()));
+        double sum = 0.0;
+        for (auto k = 0; k < m.volume; ++k) {
+            ASSERT_TRUE(m.data()[k] >= 0.0f && m.data()[k] < 1.0f);
+            sum += m.data()[k];
+        }
+        ASSERT_TRUE(std::abs(sum / m.volume - 0.5) < 0.01);
+        khustup::matrixd<float, 1000, 1500> o{};
+        o.fill_random<khustup::uniform_distribution<float>>(43);
+        ASSERT_NE(m, o);
+    }
+    {
+        khustup::matrixd<double, 300, 400> m{};
+        m.fill_random(7, khustup::normal_distribution<double>{2.0, 3.0});
+        double sum = 0.0;
+        double sq = 0.0;
+        for (auto k = 0; k < m.volume; ++k) {
+            sum += m.data()[k];
+            sq += m.data()[k] * m.data()[k];
+        }
+        const double mean = sum / m.volume;
+        ASSERT_TRUE(std::abs(mean - 2.0) < 0.05);
+        ASSERT_TRUE(std::abs(std::sqrt(sq / m.volume - mean * mean) - 3.0) < 0.05);
+    }
+    {
+        khustup::matrixd<int, 40, 50> m{};
+        m.fill_random(3, khustup::bernoulli_distribution{0.25});
+        khustup::matrixd<int, 50, 40> n{};
+        n.swap_axes<0, 1>().fill_random(3, khustup::bernoulli_distribution{0.25});
+        int ones = 0;
+        for (auto i = 0; i < 40; ++i) {
+            for (auto j = 0; j < 50; ++j) {
+                ASSERT_TRUE(m[i][j] == 0 || m[i][j] == 1);
+                ASSERT_EQ(m[i][j], n[j][i]);
+                ones += m[i][j];
+            }
+        }
+        ASSERT_TRUE(std::abs(ones / 2000.0 - 0.25) < 0.05);
+        khustup::matrixd<int, 10000> u{};
+        u.fill_random(5, khustup::uniform_distribution<int>{-3, 3});
+        for (auto k = 0; k < 10000; ++k) {
+            ASSERT_TRUE(u[k] >= -3 && u[k] <= 3);
+        }
+    }
+}
+
+template <typename I, typename K, typename O>
+void check_conv2d(const I& in, const K& k, const O& out, int sh, int sw) {
+    out.for_each_indexed([&](float v, int f, int oh, int ow) {
+            float e = 0.0f;
+            for (auto c = 0; c < std::get<1>(K::sizes); ++c) {
+                for (auto kh = 0; kh < std::get<2>(K::sizes); ++kh) {
+                    for (auto kw = 0; kw < std::get<3>(K::sizes); ++kw) {
+                        e += in[c][oh * sh + kh][ow * sw + kw] * k[f][c][kh][kw];
+                    }
+                }
+            }
+            ASSERT_TRUE(std::abs(v - e) < 0.001f);
+        });
+}
+
+TEST(matrixd, convolution_test) {
+    {
+        khustup::matrixd<float, 3, 11, 13> in{};
+        khustup::matrixd<float, 5, 3, 3, 3> k{};
+        in.fill_random<khustup::uniform_distribution<float>>(1);
+        k.fill_random<khustup::uniform_distribution<float>>(2);
+        auto out = khustup::conv2d(in, k);
+        static_assert(std::is_same<decltype(out), khustup::matrixd<float, 5, 9, 11>>::value);
+        check_conv2d(in, k, out, 1, 1);
+        auto out2 = khustup::conv2d<2, 3>(in, k);
+        static_assert(std::is_same<decltype(out2), khustup::matrixd<float, 5, 5, 4>>::value);
+        check_conv2d(in, k, out2, 2, 3);
+    }
+    {
+        khustup::matrixd<float, 2, 8, 20, 17> in{};
+        khustup::matrixd<float, 6, 8, 5, 4> k{};
+        in.fill_random<khustup::uniform_distribution<float>>(3);
+        k.fill_random<khustup::uniform_distribution<float>>(4);
+        auto out = khustup::conv2d<1, 2>(in, k);
+        static_assert(std::is_same<decltype(out), khustup::matrixd<float, 2, 6, 16, 7>>::value);
+        for (auto n = 0; n < 2; ++n) {
+            check_conv2d(in[n], k, out[n], 1, 2);
+        }
+    }
+    {
+        khustup::matrixd<float, 1, 12, 14> in{};
+        khustup::matrixd<float, 9, 1, 6, 6> k{};
+        in.fill_random<khustup::uniform_distribution<float>>(7);
+        k.fill_random<khustup::uniform_distribution<float>>(8);
+        auto out = khustup::conv2d(in, k);
+        static_assert(std::is_same<decltype(out), khustup::matrixd<float, 9, 7, 9>>::value);
+        check_conv2d(in, k, out, 1, 1);
+    }
+    {
+        khustup::matrixd<float, 4, 30> in{};
+        khustup::matrixd<float, 2, 4, 5> k{};
+        in.fill_random<khustup::uniform_distribution<float>>(5);
+        k.fill_random<khustup::uniform_distribution<float>>(6);
+        auto out = khustup::conv1d<2>(in, k);
+        static_assert(std::is_same<decltype(out), khustup::matrixd<float, 2, 13>>::value);
+        out.for_each_indexed([&](float v, int f, int o) {
+                float e = 0.0f;
+                for (auto c = 0; c < 4; ++c) {
+                    for (auto x = 0; x < 5; ++x) {
+                        e += in[c][o * 2 + x] * k[f][c][x];
+                    }
+                }
+                ASSERT_TRUE(std::abs(v - e) < 0.001f);
+            });
+        auto b = khustup::conv1d(khustup::matrixd<float, 3, 4, 30>{1.0f}, k);
+        static_assert(std::is_same<decltype(b), khustup::matrixd<float, 3, 2, 26>>::value);
+        float e = 0.0f;
+        for (auto c = 0; c < 4; ++c) {
+            for (auto x = 0; x < 5; ++x) {
+                e += k[1][c][x];
+            }
+        }
+        ASSERT_TRUE(std::abs(b[2][1][25] - e) < 0.001f);
+    }
+}
+
+TEST(matrixd, solvers_test) {
+    constexpr int count = 1003;
+    constexpr int n = 6;
+    khustup::matrixd<double, count, n, n> a{};
+    khustup::matrixd<double, count, n, 2> b{};
+    a.fill_random(11, khustup::uniform_distribution<double>{-1.0, 1.0});
+    b.fill_random(12, khustup::uniform_distribution<double>{-1.0, 1.0});
+    {
+        auto x = khustup::solve(a, b);
+        static_assert(std::is_same<decltype(x), khustup::matrixd<double, count, n, 2>>::value);
+        auto r = a.dot(x);
+        for (auto s = 0; s < count; ++s) {
+            for (auto i = 0; i < n; ++i) {
+                for (auto c = 0; c < 2; ++c) {
+                    ASSERT_TRUE(std::abs(r[s][i][c] - b[s][i][c]) < 1e-8);
+                }
+            }
+        }
+        auto [f, p] = khustup::lu(a);
+        static_assert(std::is_same<decltype(p), khustup::matrixd<int, count, n>>::value);
+        for (auto s = 0; s < count; s += 97) {
+            khustup::matrixd<double, n, n> pa{a[s]};
+            for (auto k = 0; k < n; ++k) {
+                for (auto j = 0; j < n; ++j) {
+                    std::swap(pa[k][j], pa[p[s][k]][j]);
+                }
+            }
+            for (auto i = 0; i < n; ++i) {
+                for (auto j = 0; j < n; ++j) {
+                    double e = 0.0;
+                    for (auto k = 0; k <= std::min(i, j); ++k) {
+                        e += (k == i ? 1.0 : f[s][i][k]) * f[s][k][j];
+                    }
+                    ASSERT_TRUE(std::abs(e - pa[i][j]) < 1e-10);
+                }
+            }
+        }
+    }
+    {
+        auto spd = a.dot(a.swap_axes<1, 2>());
+        for (auto s = 0; s < count; ++s) {
+            for (auto i = 0; i < n; ++i) {
+                spd[s][i][i] += 1.0;
+            }
+        }
+        auto l = khustup::cholesky(spd);
+        auto r = l.dot(l.swap_axes<1, 2>());
+        for (auto s = 0; s < count; ++s) {
+            for (auto i = 0; i < n; ++i) {
+                for (auto j = 0; j < n; ++j) {
+                    ASSERT_TRUE(std::abs(r[s][i][j] - spd[s][i][j]) < 1e-10);
+                    ASSERT_TRUE(j <= i || l[s][i][j] == 0.0);
+                }
+            }
+        }
+        auto y = khustup::trsm(l, b.crop<0, count, 0, n, 1, 1>().copy().reshape<count, n>());
+        static_assert(std::is_same<decltype(y), khustup::matrixd<double, count, n>>::value);
+        for (auto s = 0; s < count; s += 13) {
+            for (auto i = 0; i < n; ++i) {
+                double e = 0.0;
+                for (auto k = 0; k <= i; ++k) {
+                    e += l[s][i][k] * y[s][k];
+                }
+                ASSERT_TRUE(std::abs(e - b[s][i][1]) < 1e-10);
+            }
+        }
+    }
+    {
+        khustup::matrixd<float, 3, 3> m{0.0f};
+        m[0][0] = 2.0f;
+        m[1][1] = 4.0f;
+        m[2][2] = 8.0f;
+        m[0][2] = 1.0f;
+        khustup::matrixd<float, 3> v{8.0f};
+        auto x = khustup::solve(m, v);
+        ASSERT_TRUE(std::abs(x[0] - 3.5f) < 1e-6f);
+        ASSERT_TRUE(std::abs(x[1] - 2.0f) < 1e-6f);
+        ASSERT_TRUE(std::abs(x[2] - 1.0f) < 1e-6f);
+    }
+}
+
+template <typename M>
+concept has_alignment = requires { M::alignment; };
+
+TEST(matrixd, alignment_test) {
+    using m_t = khustup::matrixd<float, 30, 5>;
+    static_assert(m_t::alignment == khustup::alignment);
+    for (auto i = 0; i < 16; ++i) {
+        m_t m{1.0f};
+        khustup::matrixd<char, 7> c{};
+        ASSERT_EQ(reinterpret_cast<std::uintptr_t>(m.data()) % m_t::alignment, 0u);
+        ASSERT_EQ(reinterpret_cast<std::uintptr_t>(c.data()) % decltype(c)::alignment, 0u);
+        auto n = m.copy();
+        ASSERT_EQ(reinterpret_cast<std::uintptr_t>(n.data()) % m_t::alignment, 0u);
+        ASSERT_EQ(n[29][4], 1.0f);
+        ASSERT_EQ(c[6], 0);
+    }
+    m_t m{};
+    static_assert(has_alignment<m_t> && !has_alignment<m_t::view_type>);
+    static_assert(!has_alignment<decltype(m[1])> && !has_alignment<decltype(m.crop<1, 2, 0, 5>())>);
+    ASSERT_NE(reinterpret_cast<std::uintptr_t>(m[1].data()) % m_t::alignment, 0u);
+}
+
+TEST(matrixd, memory_resource_test) {
+    khustup::matrixd<double, 8, 8> a{1.0};
+    {
+        khustup::arena r;
+        khustup::memory_resource_scope scope{r};
+        ASSERT_EQ(khustup::current_memory_resource(), &r);
+        auto b = a.copy();
+        auto c = a.dot(b) + b;
+        ASSERT_EQ(reinterpret_cast<std::uintptr_t>(c.data()) % decltype(c)::alignment, 0u);
+        ASSERT_EQ(c[3][4], 9.0);
+    }
+    {
+        khustup::arena r;
+        khustup::memory_resource_scope scope{r};
+        std::array<std::pmr::memory_resource*, khustup::threads> used{};
+        khustup::impl::parallel_for(khustup::threads, [&](int64_t start, int64_t end) {
+            for (auto t = start; t < end; ++t) {
+                khustup::matrixd<double, 64, 64> b{1.0};
+                used[t] = b.dot(b)[1][2] == 64.0 ? khustup::current_memory_resource() : nullptr;
+            }
+        });
+        for (auto u : used) {
+            ASSERT_EQ(u, &r);
+        }
+    }
+    ASSERT_EQ(khustup::current_memory_resource(), khustup::default_memory_resource());
+    khustup::pool p;
+    for (auto i = 0; i < 4; ++i) {
+        khustup::matrixd<float, 3, 5> m{&p};
+        ASSERT_EQ(reinterpret_cast<std::uintptr_t>(m.data()) % decltype(m)::alignment, 0u);
+        ASSERT_EQ(m[2][4], 0.0f);
+        auto n = std::move(m);
+        n[1][1] = 2.0f;
+        ASSERT_EQ(n[1][1], 2.0f);
+    }
+}
+
+TEST(matrixd, uninitialized_test) {
+    khustup::pool p;
+    khustup::memory_resource_scope scope{p};
+    khustup::matrixd<double, 4, 3> a{2.0};
+    khustup::matrixd<double, 3, 5> b{3.0};
+    for (auto i = 0; i < 3; ++i) {
+        {
+            khustup::matrixd<double, 4, 5> dirty{7.0};
+        }
+        auto c = a.dot(b);
+        ASSERT_EQ(c[3][4], 18.0);
+        ASSERT_EQ(c[0][0], 18.0);
+    }
+    khustup::matrixd<int, 2, 2> u{khustup::uninitialized};
+    u = 5;
+    ASSERT_EQ(u[1][1], 5);
+    auto s = (a + a).sqrt();
+    ASSERT_EQ(s[3][2], 2.0);
+}
+
+TEST(matrixd, inline_storage_test) {
+    using v_t = khustup::matrixd<float, 3>;
+    using m_t = khustup::matrixd<float, 4, 4>;
+    static_assert(v_t::is_inline && m_t::is_inline);
+    static_assert(!khustup::matrixd<float, 5, 4>::is_inline);
+    static_assert(v_t::alignment == 16 && m_t::alignment == 64);
+    static_assert(sizeof(v_t) <= 48);
+    struct counting_resource : std::pmr::memory_resource
+    {
+        int count = 0;
+        void* do_allocate(std::size_t b, std::size_t a) override
+        {
+            ++count;
+            return khustup::default_memory_resource()->allocate(b, a);
+        }
+        void do_deallocate(void* p, std::size_t b, std::size_t a) override
+        {
+            khustup::default_memory_resource()->deallocate(p, b, a);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& o) const noexcept override
+        {
+            return this == &o;
+        }
+    } r;
+    khustup::memory_resource_scope scope{r};
+    m_t a{2.0f};
+    auto b = a.copy();
+    auto c = a.dot(b) + b;
+    auto d = std::move(c);
+    ASSERT_EQ(d.data() != c.data(), true);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(d.data()) % m_t::alignment, 0u);
+    ASSERT_EQ(d[3][3], 18.0f);
+    auto t = std::move(d).swap_axes<0, 1>();
+    ASSERT_EQ(t[1][2], 18.0f);
+    auto e = m_t{1.0f}.crop<1, 2, 0, 4>();
+    ASSERT_EQ(e[1][3], 1.0f);
+    v_t v{1.0f};
+    v = v_t{3.0f};
+    ASSERT_EQ(v[2], 3.0f);
+    ASSERT_EQ(r.count, 0);
+    khustup::matrixd<float, 5, 4> h{};
+    ASSERT_EQ(r.count, 1);
+}
+
+TEST(matrixd, shared_test) {
+    khustup::matrixd<float, 100, 10> a{1.0f};
+    auto b = a.share();
+    const auto& cb = b;
+    ASSERT_EQ(cb.data(), std::as_const(a).data());
+    std::vector<khustup::matrixd<float, 100, 10>> consumers(8, b);
+    for (const auto& c : consumers) {
+        ASSERT_EQ(c.data(), cb.data());
+        ASSERT_EQ(c[99][9], 1.0f);
+    }
+    b[3][4] = 2.0f;
+    ASSERT_NE(cb.data(), std::as_const(a).data());
+    ASSERT_EQ(a[3][4], 1.0f);
+    ASSERT_EQ(b[3][4], 2.0f);
+    ASSERT_EQ(consumers[5][3][4], 1.0f);
+    consumers[0] += 1.0f;
+    ASSERT_EQ(consumers[0][0][0], 2.0f);
+    ASSERT_EQ(consumers[1][0][0], 1.0f);
+    auto t = std::move(consumers[2]).swap_axes<0, 1>();
+    ASSERT_EQ(t[9][99], 1.0f);
+    consumers.clear();
+    a.map_inplace([](float v) { return v * 3.0f; });
+    ASSERT_EQ(a[0][0], 3.0f);
+    ASSERT_EQ(t[0][0], 1.0f);
+    auto v = t.share();
+    ASSERT_EQ(v[1][1], 1.0f);
+
+    khustup::matrixd<float, 4, 3> g{1.0f};
+    auto h = g.share();
+    auto gc = g.crop<0, 2, 0, 2>();
+    gc.at(0, 0) = 42.0f;
+    ASSERT_EQ(h.at(0, 0), 1.0f);
+    ASSERT_EQ(g.at(0, 0), 42.0f);
+    auto k = h.share();
+    auto hs = h.swap_axes<0, 1>();
+    hs.at(2, 3) = 5.0f;
+    ASSERT_EQ(k.at(3, 2), 1.0f);
+    ASSERT_EQ(h.at(3, 2), 5.0f);
+    auto l = k.share();
+    k.reshape<12>().at(11) = 6.0f;
+    ASSERT_EQ(l.at(3, 2), 1.0f);
+    ASSERT_EQ(k.at(3, 2), 6.0f);
+    static_assert(std::is_same<decltype(std::as_const(l).crop<0, 2, 0, 2>().data()), const float*>::value);
+}
+
+template <typename F>
+void check_shared_write(const F& write)
+{
+    using m_t = khustup::matrixd<int, 40, 40>;
+    m_t a{1};
+    const auto b = a.share();
+    write(a);
+    ASSERT_EQ(b, m_t{1});
+    ASSERT_NE(a, b);
+}
+
+template <typename V>
+concept read_only = std::is_const<std::remove_pointer_t<decltype(std::declval<V&>().data())>>::value;
+
+TEST(matrixd, shared_view_test) {
+    check_shared_write([](auto& a) { a[1][1] = 7; });
+    check_shared_write([](auto& a) { a.at(1, 1) = 7; });
+    check_shared_write([](auto& a) { a.sub(1)[1] = 7; });
+    check_shared_write([](auto& a) { a.template crop<0, 2, 0, 2>().at(1, 1) = 7; });
+    check_shared_write([](auto& a) { a.template swap_axes<0, 1>().at(1, 2) = 7; });
+    check_shared_write([](auto& a) { a.template slice<0, 20, 2, 0, 40, 1>().at(1, 1) = 7; });
+    check_shared_write([](auto& a) { a.template reshape<1600>().at(41) = 7; });
+    check_shared_write([](auto& a) {
+        for (auto r : a.template axis_range<1>()) {
+            r.at(1) = 7;
+        }
+    });
+    check_shared_write([](auto& a) {
+        typename std::remove_cvref_t<decltype(a)>::view_type v = a;
+        v.at(1, 1) = 7;
+    });
+    check_shared_write([](auto& a) { *a.begin() = 7; });
+    check_shared_write([](auto& a) { a.data()[41] = 7; });
+#if defined(__cpp_lib_mdspan)
+    check_shared_write([](auto& a) {
+        auto s = a.to_mdspan();
+        s.data_handle()[s.stride(0) + 1] = 7;
+    });
+#endif
+
+    using m_t = khustup::matrixd<int, 40, 40>;
+    const m_t c{1};
+    static_assert(read_only<decltype(c[1])> && read_only<decltype(c.sub(1))>);
+    static_assert(read_only<decltype(c.crop<0, 2, 0, 2>())> && read_only<decltype(c.swap_axes<0, 1>())>);
+    static_assert(read_only<decltype(c.slice<0, 20, 2, 0, 40, 1>())> && read_only<decltype(c.reshape<1600>())>);
+    static_assert(read_only<decltype(*c.axis_range<1>().begin())>);
+    static_assert(!std::is_convertible<const m_t&, m_t::view_type>::value);
+    static_assert(std::is_convertible<const m_t&, m_t::const_view_type>::value);
+    m_t::const_view_type v = c;
+    ASSERT_EQ(v.data(), c.data());
+    ASSERT_EQ(v, c);
+}
+
+TEST(matrixd, map_file_test) {
+    using m_t = khustup::matrixd<float, 300, 20>;
+    const auto path = (std::filesystem::temp_directory_path() / "matrixd_map_file_test.khm").string();
+    {
+        auto m = m_t::map_file(path.c_str(), khustup::map_mode::create);
+        ASSERT_FALSE(m == nullptr);
+        m.fill_random(5, khustup::uniform_distribution<float>{});
+        m[299][19] = 7.0f;
+    }
+    ASSERT_EQ(std::filesystem::file_size(path), 64 + m_t::volume * sizeof(float));
+    {
+        const auto m = m_t::map_file(path.c_str(), khustup::map_mode::read_only, khustup::map_advice::sequential);
+        ASSERT_FALSE(m == nullptr);
+        ASSERT_EQ(m[299][19], 7.0f);
+        m_t e{};
+        e.fill_random(5, khustup::uniform_distribution<float>{});
+        ASSERT_EQ(m[3][4], e[3][4]);
+        auto c = m.copy();
+        c[0][0] = 1.0f;
+        ASSERT_EQ(c[299][19], 7.0f);
+    }
+    {
+        auto m = m_t::map_file(path.c_str());
+        m.at(299, 19) = 2.0f;
+        m += 1.0f;
+        ASSERT_EQ(m.at(299, 19), 3.0f);
+    }
+    {
+        auto m = m_t::map_file(path.c_str(), khustup::map_mode::copy_on_write);
+        m[299][19] = 1.0f;
+        auto s = m.share();
+        s[0][0] = 2.0f;
+        ASSERT_EQ(m[0][0] == 2.0f, false);
+    }
+    {
+        auto m = m_t::map_file(path.c_str(), khustup::map_mode::shared, khustup::map_advice::willneed);
+        ASSERT_EQ(m[299][19], 7.0f);
+    }
+    ASSERT_TRUE((khustup::matrixd<float, 20, 300>::map_file(path.c_str()) == nullptr));
+    ASSERT_TRUE((khustup::matrixd<int, 300, 20>::map_file(path.c_str()) == nullptr));
+    ASSERT_TRUE((m_t::map_file((path + ".missing").c_str()) == nullptr));
+    std::filesystem::remove(path);
+}
+
+TEST(matrixd, save_load_test) {
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto path = (dir / "matrixd_save_load_test.khm").string();
+    const auto npy = (dir / "matrixd_save_load_test.npy").string();
+    khustup::matrixd<double, 40, 30> m{};
+    m.fill_random(3, khustup::normal_distribution<double>{});
+    auto v = m.crop<5, 20, 3, 10>().swap_axes<0, 1>();
+    ASSERT_TRUE(v.save(path.c_str()));
+    ASSERT_EQ(std::filesystem::file_size(path), 64 + 200 * sizeof(double));
+    const auto l = khustup::matrixd<double, 10, 20>::load(path.c_str());
+    ASSERT_FALSE(l == nullptr);
+    for (auto i = 0; i < 10; ++i) {
+        for (auto j = 0; j < 20; ++j) {
+            ASSERT_EQ(l[i][j], m[j + 5][i + 3]);
+        }
+    }
+    ASSERT_TRUE((khustup::matrixd<double, 20, 10>::load(path.c_str()) == nullptr));
+    ASSERT_TRUE((khustup::matrixd<float, 10, 20>::load(path.c_str()) == nullptr));
+    ASSERT_TRUE((decltype(v)::load(path.c_str()) == l));
+    const auto mapped = khustup::matrixd<double, 10, 20>::map_file(path.c_str());
+    ASSERT_TRUE((mapped == l));
+
+    ASSERT_TRUE(v.save_npy(npy.c_str()));
+    ASSERT_EQ((std::filesystem::file_size(npy) - 200 * sizeof(double)) % 64, 0u);
+    const auto n = khustup::matrixd<double, 10, 20>::load_npy(npy.c_str());
+    ASSERT_TRUE((n == l));
+    ASSERT_TRUE((khustup::matrixd<double, 200>::load_npy(npy.c_str()) == nullptr));
+    ASSERT_TRUE((khustup::matrixd<int64_t, 10, 20>::load_npy(npy.c_str()) == nullptr));
+
+    khustup::matrixd<int, 7> s{};
+    s[6] = 42;
+    ASSERT_TRUE(s.save_npy(npy.c_str()));
+    const auto sl = khustup::matrixd<int, 7>::load_npy(npy.c_str());
+    ASSERT_EQ(sl[6], 42);
+    std::filesystem::remove(path);
+    std::filesystem::remove(npy);
+}
+
+TEST(matrixd, inline_move_test) {
+    khustup::matrixd<float, 4, 4> a{1.0f};
+    static_assert(decltype(a)::is_inline);
+    auto v = a[1];
+    const float* p = a.data();
+    auto i = a.begin();
+    auto b = std::move(a);
+    b[1][1] = 5.0f;
+    ASSERT_NE(b.data(), p);
+    ASSERT_EQ(v.data(), p + 4);
+    ASSERT_EQ(&*i, p);
+    ASSERT_EQ(v[1], 1.0f);
+    khustup::matrixd<float, 40, 40> h{1.0f};
+    static_assert(!decltype(h)::is_inline);
+    auto w = h[1];
+    const float* q = h.data();
+    auto g = std::move(h);
+    g[1][1] = 5.0f;
+    ASSERT_EQ(g.data(), q);
+    ASSERT_EQ(w[1], 5.0f);
+}
+
+TEST(matrixd, numa_test) {
+    for (auto policy : {khustup::numa_policy::first_touch, khustup::numa_policy::interleave}) {
+        khustup::numa_memory_resource r{policy};
+        ASSERT_EQ(r.policy(), policy);
+        khustup::memory_resource_scope scope{r};
+        khustup::matrixd<float, 1200, 1000> a{};
+        ASSERT_EQ(reinterpret_cast<std::uintptr_t>(a.data()) % decltype(a)::alignment, 0u);
+        ASSERT_EQ(a[1199][999], 0.0f);
+        a += 1.0f;
+        khustup::matrixd<float, 1000, 8> b{2.0f};
+        auto c = a.dot(b);
+        ASSERT_EQ(c[0][0], 2000.0f);
+        ASSERT_EQ(c[1199][7], 2000.0f);
+        khustup::matrixd<float, 4, 4> s{1.0f};
+        ASSERT_EQ(s.dot(s)[3][3], 4.0f);
+    }
+}
+
+template <typename M>
+concept rebindable = requires(M& m, const M& o) { m.rebind(o); };
+
+TEST(matrixd, matrix_view_test) {
+    using m_t = khustup::matrixd<int, 4, 5, 6>;
+    m_t m{};
+    std::iota(m.data(), m.data() + m_t::volume, 0);
+    using row_t = decltype(m[0]);
+    static_assert(std::is_same<row_t, m_t::submatrix_type<1>::view_type>::value);
+    static_assert(std::is_trivially_copy_constructible<row_t>::value && std::is_trivially_destructible<row_t>::value);
+    static_assert(sizeof(row_t) == sizeof(int*));
+    static_assert(std::is_trivially_copy_constructible<decltype(m.sub(1, 2))>::value);
+    static_assert(std::is_trivially_copy_constructible<decltype(m.crop<1, 2, 0, 5, 1, 3>())>::value);
+    static_assert(std::is_trivially_copy_constructible<decltype(m.swap_axes<0, 2>())>::value);
+    static_assert(!std::is_trivially_copy_constructible<decltype(m_t{}.crop<1, 2, 0, 5, 1, 3>())>::value);
+
+    const auto sum = [](khustup::matrixd<int, 6>::view_type r) {
+        return std::accumulate(r.data(), r.data() + 6, 0);
+    };
+    khustup::matrixd<int, 6> o{1};
+    ASSERT_EQ(sum(o), 6);
+    ASSERT_EQ(sum(m[0][1]), 6 + 7 + 8 + 9 + 10 + 11);
+
+    m_t::view_type v = m;
+    ASSERT_EQ(v.data(), m.data());
+    ASSERT_EQ(v.at(1, 2, 3), m.at(1, 2, 3));
+    v[0] = v[1];
+    ASSERT_EQ(m[0], m[1]);
+    ASSERT_EQ(m[0][0][0], 30);
+
+    static_assert(rebindable<decltype(v)> && !rebindable<m_t> && !rebindable<khustup::matrixd<float, 100>>);
+    auto r = v[2];
+    r.rebind(v[3]);
+    ASSERT_EQ(r.data(), m[3].data());
+    ASSERT_NE(m[2], m[3]);
+    r += 1;
+    ASSERT_EQ(m[3][0][0], 91);
+    auto w = v[2];
+    w = v[3];
+    ASSERT_EQ(w.data(), m[2].data());
+    ASSERT_EQ(m[2], m[3]);
+
+    const auto c = m.crop<1, 2, 0, 5, 1, 3>();
+    ASSERT_EQ(c[1][4][2], m[2][4][3]);
+    ASSERT_EQ((m.swap_axes<0, 2>()[5][4][3]), m[3][4][5]);
+}
+
+TEST(matrixd, index_type_test) {
+    using big_t = khustup::matrixd<char, 4, 1000000000>;
+    static_assert(std::is_same<khustup::matrixd<float, 1000, 1000>::index_type, int>::value);
+    static_assert(std::is_same<big_t::index_type, std::ptrdiff_t>::value);
+    static_assert(std::is_same<big_t::submatrix_type<1>::index_type, int>::value);
+    static_assert(std::is_same<big_t::swap_axes_matrix_type<0, 1>::submatrix_type<1>::index_type,
+                               std::ptrdiff_t>::value);
+    static_assert(khustup::matrixd<float, 50000000, 64>::raw_offset(49999999, 63) == 3199999999);
+    static_assert(big_t::raw_offset(3, 999999999) == big_t::volume - 1);
+#ifdef __unix__
+    void* p = ::mmap(nullptr, big_t::volume, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    ASSERT_NE(p, MAP_FAILED);
+    auto* d = static_cast<char*>(p);
+    big_t m{d, d + big_t::volume};
+    m[3][999999999] = 7;
+    m.at(2, 5) = 3;
+    ASSERT_EQ(d[big_t::volume - 1], 7);
+    ASSERT_EQ(d[2000000005], 3);
+    ASSERT_EQ((m.swap_axes<0, 1>()[999999999][3]), 7);
+    ASSERT_EQ(m.sub(3)[999999999], 7);
+    ::munmap(p, big_t::volume);
+#endif
+}
+
+TEST(matrixd, dynamic_extent_test) {
+    using b_t = khustup::matrixd<float, khustup::dynamic_extent, 3, 4>;
+    static_assert(std::is_same<b_t, khustup::impl::dynamic_matrix_impl<khustup::matrixd<float, 3, 4>>>::value);
+    static_assert(b_t::dimensions == 3);
+    const khustup::matrixd<float, 4, 2> w{1.0f};
+    khustup::matrixd<float, 1, 4> row;
+    std::iota(row.data(), row.data() + row.volume, 1.0f);
+    for (int n : {1, 7, 100000}) {
+        b_t a{n};
+        std::iota(a.data(), a.data() + a.volume(), 0.0f);
+        ASSERT_EQ(a.size(), n);
+        ASSERT_EQ(a.at(n - 1, 2, 3), static_cast<float>(n * 12 - 1));
+
+        const auto p = a * a;
+        ASSERT_EQ(p[n - 1][1][2], a[n - 1][1][2] * a[n - 1][1][2]);
+
+        auto b = a.copy();
+        b += row;
+        ASSERT_EQ(b[n - 1][2][3], a[n - 1][2][3] + 4.0f);
+        b -= a;
+        ASSERT_EQ(b[n / 2][1][0], 1.0f);
+
+        const auto m = a.map([](float v) { return static_cast<int>(v) % 5; });
+        static_assert(std::is_same<std::remove_cvref_t<decltype(m[0][0][0])>, int>::value);
+        ASSERT_EQ(m.at(n - 1, 2, 3), (n * 12 - 1) % 5);
+
+        const auto d = a.dot(w);
+        static_assert(std::is_same<std::remove_cvref_t<decltype(d)>,
+                                   khustup::matrixd<float, khustup::dynamic_extent, 3, 2>>::value);
+        for (int i : {0, n / 2, n - 1}) {
+            ASSERT_EQ(d[i], a[i].dot(w));
+        }
+    }
+
+    b_t small{2, 1.0f};
+    b_t large{50, 2.0f};
+    small = large;
+    ASSERT_EQ(small.size(), 50);
+    ASSERT_EQ(small.at(49, 2, 3), 2.0f);
+    large = b_t{3, 4.0f};
+    ASSERT_EQ(large.size(), 3);
+    b_t empty{nullptr};
+    empty = large;
+    ASSERT_EQ(empty, large);
+    ASSERT_TRUE((small + large) == nullptr);
+    ASSERT_TRUE((large.zip_with(small, [](float x, float y) { return x * y; })) == nullptr);
+}
+
+#if defined(__cpp_lib_mdspan)
+TEST(matrixd, mdspan_test) {
+    khustup::matrixd<float, 4, 5, 6> m;
+    std::iota(m.data(), m.data() + m.volume, 0.0f);
+
+    auto s = m.to_mdspan();
+    static_assert(decltype(s)::extents_type::static_extent(1) == 5);
+    ASSERT_EQ(s.data_handle(), m.data());
+    ASSERT_EQ(s.stride(0), 30);
+    ASSERT_EQ(s.data_handle()[3 * s.stride(0) + 4 * s.stride(1) + 5 * s.stride(2)], m[3][4][5]);
+
+    auto c = m.crop<1, 2, 0, 5, 2, 3>().swap_axes<0, 2>();
+    auto cs = c.to_mdspan();
+    ASSERT_EQ(cs.extent(0), 3);
+    ASSERT_EQ(cs.stride(0), 1);
+    ASSERT_EQ(cs.data_handle()[2 * cs.stride(0) + 4 * cs.stride(1) + cs.stride(2)], c[2][4][1]);
+    auto cv = khustup::from_mdspan<decltype(c)>(cs);
+    ASSERT_EQ(cv.data(), c.data());
+    ASSERT_EQ(cv, c);
+
+    std::mdspan<float, std::extents<int, 4, 5, 6>> r{m.data()};
+    auto v = khustup::from_mdspan(r);
+    static_assert(std::is_same<decltype(v), khustup::matrixd<float, 4, 5, 6>::view_type>::value);
+    v[3][4][5] = -1.0f;
+    ASSERT_EQ(m[3][4][5], -1.0f);
+
+    khustup::matrixd<float, khustup::dynamic_extent, 2, 3> b{7};
+    auto bs = b.to_mdspan();
+    ASSERT_EQ(bs.extent(0), 7);
+    ASSERT_EQ(bs.stride(0), 6);
+}
+#endif
+
+TEST(matrixd, shape_types_test) {
+    using m_t = khustup::matrixd<float, 2, 3, 4, 5>;
+    static_assert(m_t::sizes == std::make_tuple(2, 3, 4, 5));
+    static_assert(m_t::absolute_offsets == std::make_tuple(60, 20, 5, 1));
+    static_assert(std::is_same<m_t::swap_axes_matrix_type<1, 3>,
+                               khustup::impl::matrix_impl<float, 2, 60, 0, 2, 5, 1, 0, 5, 4, 5, 0, 4, 3, 20, 0, 3>>::value);
+    static_assert(std::is_same<m_t::cropped_matrix_type<1, 1, 1, 2>,
+                               khustup::impl::matrix_impl<float, 2, 60, 1, 1, 3, 20, 1, 2, 4, 5, 0, 4, 5, 1, 0, 5>>::value);
+    static_assert(m_t::cropped_matrix_type<0, 2, 1, 2>::cropped_matrix_type<0, 1, 0, 1>::offsets ==
+                  std::make_tuple(0, 1, 0, 0));
+    static_assert(std::is_same<m_t::submatrix_type<2>, khustup::matrixd<float, 4, 5>>::value);
+    static_assert(std::is_same<m_t::swap_axes_matrix_type<0, 2>::continuous_matrix_type,
+                               khustup::matrixd<float, 4, 3, 2, 5>>::value);
+    static_assert(std::is_same<m_t::dot_product_type<khustup::matrixd<float, 1, 3, 5, 7>>,
+                               khustup::matrixd<float, 2, 3, 4, 7>>::value);
+    static_assert(std::is_same<m_t::max_size_matrix_type<khustup::matrixd<int, 2, 1, 4, 1>>, m_t>::value);
+    static_assert(khustup::impl::volume<2, 60, 1, 1, 3, 20, 0, 3> == 3);
+}
+
+TEST(matrixd, iterator_test) {
+    khustup::matrixd<int, 4, 5, 6> m;
+    std::iota(m.begin(), m.end(), 0);
+    static_assert(std::is_same<decltype(m)::iterator, int*>::value);
+    ASSERT_EQ(std::reduce(std::execution::par_unseq, m.begin(), m.end()), 119 * 120 / 2);
+
+    auto s = m.crop<1, 2, 1, 3, 0, 6>().swap_axes<0, 2>();
+    using s_t = decltype(s);
+    static_assert(std::random_access_iterator<s_t::iterator>);
+    static_assert(std::random_access_iterator<s_t::const_iterator>);
+    ASSERT_EQ(s.end() - s.begin(), s.volume);
+    ASSERT_EQ(s.begin()[7], s[1][0][1]);
+    ASSERT_EQ(*(s.end() - 1), s[5][2][1]);
+
+    khustup::matrixd<int, 6, 3, 2> t;
+    std::transform(std::execution::par_unseq, s.begin(), s.end(), t.begin(), [](int v) { return -v; });
+    ASSERT_EQ(t, s.map([](int v) { return -v; }));
+
+    std::sort(s.begin(), s.end(), std::greater<>{});
+    ASSERT_TRUE(std::is_sorted(s.begin(), s.end(), std::greater<>{}));
+    ASSERT_EQ(s.at(0, 0, 0), 83);
+    ASSERT_EQ(m.at(1, 1, 0), 83);
+    ASSERT_EQ(m.at(2, 3, 5), 36);
+    ASSERT_EQ(m.at(0, 0, 0), 0);
+
+    int i = 0;
+    const auto w = m.swap_axes<0, 1>();
+    for (auto v : m.axis_range<1>()) {
+        ASSERT_EQ(v, w[i++]);
+    }
+    ASSERT_EQ(i, 5);
+
+    auto shared = m.share();
+    for (auto v : m.axis_range<2>()) {
+        v += 1;
+    }
+    ASSERT_EQ(m.at(3, 2, 1), shared.at(3, 2, 1) + 1);
+
+    khustup::matrixd<int, khustup::dynamic_extent, 2, 2> d{3};
+    std::fill(d.begin(), d.end(), 2);
+    ASSERT_EQ(std::reduce(d.begin(), d.end()), 24);
+}
+
+TEST(matrixd, slice_test) {
+    khustup::matrixd<int, 6, 7, 3> m;
+    std::iota(m.begin(), m.end(), 0);
+
+    auto s = m.slice<1, 3, 2, 0, 4, 2, 0, 3, 1>();
+    static_assert(s.sizes == std::make_tuple(3, 4, 3));
+    static_assert(s.absolute_offsets == std::make_tuple(42, 6, 1));
+    static_assert(!s.is_continuous);
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            for (int k = 0; k < 3; ++k) {
+                ASSERT_EQ(s.at(i, j, k), m.at(1 + 2 * i, 2 * j, k));
+            }
+        }
+    }
+    ASSERT_EQ(s[2][3], m[5][6]);
+    ASSERT_EQ(*(s.end() - 1), m.at(5, 6, 2));
+
+    auto odd = m.slice<0, 6, 1, 0, 7, 1, 1, 1, 2>();
+    ASSERT_EQ(odd.copy(), (m.crop<0, 6, 0, 7, 1, 1>().copy()));
+    auto c = m.crop<1, 4, 1, 6, 0, 3>().slice<1, 2, 2, 1, 2, 3, 2, 1, 1>();
+    static_assert(c.sizes == std::make_tuple(2, 2, 1));
+    ASSERT_EQ(c.at(1, 1, 0), m.at(4, 5, 2));
+
+    s += 1000;
+    ASSERT_EQ(m.at(3, 2, 1), 1000 + 3 * 21 + 2 * 3 + 1);
+    ASSERT_EQ(m.at(2, 2, 1), 2 * 21 + 2 * 3 + 1);
+
+    khustup::matrixd<int, 9> v;
+    std::iota(v.begin(), v.end(), 0);
+    auto e = v.slice<1, 4, 2>();
+    ASSERT_EQ(e.at(0), 1);
+    ASSERT_EQ(e.at(3), 7);
+    ASSERT_EQ((e.slice<1, 2, 2>().at(1)), 7);
+
+    auto shared = m.share();
+    m.slice<0, 3, 2, 0, 7, 1, 0, 3, 1>() += 1;
+    ASSERT_EQ(m.at(4, 6, 2), shared.at(4, 6, 2) + 1);
+    ASSERT_EQ(m.at(3, 6, 2), shared.at(3, 6, 2));
+
+    auto t = (m + 1).slice<0, 2, 3, 0, 1, 1, 0, 3, 1>();
+    static_assert(std::is_same<decltype(t), khustup::matrixd<int, 2, 1, 3>>::value);
+    ASSERT_EQ(t.at(1, 0, 2), m.at(3, 0, 2) + 1);
+}
+
+TEST(matrixd, strided_reshape_test) {
+    khustup::matrixd<int, 6, 4, 5> m;
+    std::iota(m.begin(), m.end(), 0);
+
+    auto c = m.crop<2, 4, 0, 4, 0, 5>();
+    auto r = c.reshape<2, 2, 20>();
+    static_assert(r.is_continuous);
+    ASSERT_EQ(r.data(), &m.at(2, 0, 0));
+    ASSERT_EQ(r.at(1, 1, 13), m.at(5, 2, 3));
+
+    auto s = m.crop<0, 6, 1, 2, 0, 5>().reshape<3, 2, 2, 5>();
+    static_assert(!s.is_continuous);
+    static_assert(s.absolute_offsets == std::make_tuple(40, 20, 5, 1));
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 2; ++j) {
+            for (int k = 0; k < 2; ++k) {
+                ASSERT_EQ(s[i][j][k], m[2 * i + j][1 + k]);
+            }
+        }
+    }
+
+    auto t = m.swap_axes<0, 2>().reshape<5, 2, 2, 6>();
+    ASSERT_EQ(t.at(3, 1, 0, 4), m.at(4, 2, 3));
+    auto e = m.slice<1, 3, 2, 0, 4, 1, 0, 5, 1>().reshape<3, 20>();
+    ASSERT_EQ(e.at(2, 7), m.at(5, 1, 2));
+    auto u = m.crop<0, 6, 1, 2, 0, 5>().reshape<6, 1, 2, 5>();
+    ASSERT_EQ(u.at(5, 0, 1, 4), m.at(5, 2, 4));
+
+    auto p = m.crop<0, 6, 0, 4, 1, 3>().reshape_copy<72>();
+    static_assert(std::is_same<decltype(p), khustup::matrixd<int, 72>>::value);
+    ASSERT_EQ(p.at(71), m.at(5, 3, 3));
+    ASSERT_EQ(p.at(4), m.at(0, 1, 2));
+
+    auto o = khustup::matrixd<int, 6, 4, 5>{m}.crop<1, 4, 0, 4, 0, 5>().reshape<80>();
+    static_assert(std::is_same<decltype(o), khustup::matrixd<int, 80>>::value);
+    ASSERT_EQ(o.at(79), m.at(4, 3, 4));
+}
+
+TEST(matrixd, concat_test) {
+    khustup::matrixd<int, 2, 3, 4> a;
+    khustup::matrixd<int, 2, 1, 4> b;
+    khustup::matrixd<int, 2, 2, 4> c;
+    std::iota(a.begin(), a.end(), 0);
+    std::iota(b.begin(), b.end(), 100);
+    std::iota(c.begin(), c.end(), 200);
+
+    auto r = khustup::concat<1>(a, b, c);
+    static_assert(std::is_same<decltype(r), khustup::matrixd<int, 2, 6, 4>>::value);
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_EQ((r[i].crop<0, 3, 0, 4>()), a[i]);
+        ASSERT_EQ((r[i].crop<3, 1, 0, 4>()), b[i]);
+        ASSERT_EQ((r[i].crop<4, 2, 0, 4>()), c[i]);
+    }
+
+    auto r0 = khustup::concat<0>(a, a.crop<1, 1, 0, 3, 0, 4>(), a.cast<float>());
+    static_assert(std::is_same<decltype(r0), khustup::matrixd<float, 5, 3, 4>>::value);
+    ASSERT_EQ(r0.at(2, 1, 3), a.at(1, 1, 3));
+    ASSERT_EQ(r0.at(4, 2, 0), a.at(1, 2, 0));
+
+    khustup::matrixd<int, 2, 3, 8> d;
+    khustup::concat_into<2>(d, a.swap_axes<1, 1>(), a);
+    ASSERT_EQ((d.crop<0, 2, 0, 3, 4, 4>()), a);
+    khustup::matrixd<int, 3, 2, 8> e;
+    khustup::concat_into<2>(e.swap_axes<0, 1>(), a, a + 1);
+    ASSERT_EQ(e.at(2, 1, 7), a.at(1, 2, 3) + 1);
+    auto f = d.share();
+    khustup::concat_into<2>(d, a.swap_axes<1, 1>(), (a * 2).cast<float>());
+    ASSERT_EQ(f.at(1, 2, 7), a.at(1, 2, 3));
+    ASSERT_EQ(d.at(1, 2, 7), a.at(1, 2, 3) * 2);
+    auto g = d.share();
+    khustup::concat_into<2>(d, a + 1, a);
+    ASSERT_EQ(g.at(1, 2, 3), a.at(1, 2, 3));
+    ASSERT_EQ(d.at(1, 2, 3), a.at(1, 2, 3) + 1);
+
+    auto s = khustup::stack<1>(a, a + 1, a + 2);
+    static_assert(std::is_same<decltype(s), khustup::matrixd<int, 2, 3, 3, 4>>::value);
+    ASSERT_EQ((s.swap_axes<0, 1>()[2]), a + 2);
+    auto s2 = khustup::stack<3>(a.swap_axes<0, 1>(), a.swap_axes<0, 1>());
+    static_assert(std::is_same<decltype(s2), khustup::matrixd<int, 3, 2, 4, 2>>::value);
+    ASSERT_EQ(s2.at(2, 1, 3, 1), a.at(1, 2, 3));
+
+    khustup::matrixd<int, 1000, 2000> big{khustup::uninitialized};
+    khustup::matrixd<int, 1000, 500> part{7};
+    khustup::concat_into<1>(big, part, part * 2, part * 3, part * 4);
+    ASSERT_EQ(big.at(999, 1999), 28);
+    ASSERT_EQ(big.at(500, 600), 14);
+}